@@ -5,6 +5,11 @@
   Purpose:      Implementation for the AdaptAI class library.
 *****************************************************************************/
 
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
 #include "AdaptAI.h"
 
 using namespace AdaptAI;
@@ -14,13 +19,179 @@ using namespace AdaptAI;
 //
 
 float AdaptAI::Random () {
-   return rand () / (float) RAND_MAX;
+   return GetGenerator ().Random ();
+}
+
+float *AdaptAI::AllocateAligned (size_t Count) {
+   if (Count == 0)
+      return NULL;
+
+   // Over-allocate and keep the raw pointer just below the aligned block:
+   char *Raw = new char [Count * sizeof (float) + ADAPTAI_ALIGNMENT + sizeof (char *)];
+
+   size_t Addr = (size_t) (Raw + sizeof (char *));
+
+   Addr = (Addr + ADAPTAI_ALIGNMENT - 1) & ~((size_t) ADAPTAI_ALIGNMENT - 1);
+
+   ((char **) Addr) [-1] = Raw;
+
+   return (float *) Addr;
+}
+
+void AdaptAI::FreeAligned (float *Block) {
+   if (Block == NULL)
+      return;
+
+   delete [] ((char **) Block) [-1];
+}
+
+//
+// GenomePool implementation
+//
+
+GenomePool::GenomePool () {
+   Cached = 0;
+}
+
+GenomePool::~GenomePool () {
+   Trim ();
+}
+
+float *GenomePool::Allocate (size_t Count) {
+   if (Count == 0)
+      return NULL;
+
+   {
+      std::lock_guard<std::mutex> Guard (Lock);
+
+      std::unordered_map<size_t, std::vector<float *> >::iterator i = Blocks.find (Count);
+
+      if (i != Blocks.end () && !i->second.empty ()) {
+         float *Block = i->second.back ();
+
+         i->second.pop_back ();
+
+         Cached -= Count;
+
+         return Block;
+      }
+   }
+
+   return AllocateAligned (Count);
+}
+
+bool GenomePool::Release (float *Block, size_t Count) {
+   if (Block == NULL)
+      return false;
+
+   std::lock_guard<std::mutex> Guard (Lock);
+
+   Blocks [Count].push_back (Block);
+
+   Cached += Count;
+
+   return true;
+}
+
+bool GenomePool::Trim () {
+   std::lock_guard<std::mutex> Guard (Lock);
+
+   std::unordered_map<size_t, std::vector<float *> >::iterator i;
+
+   for (i = Blocks.begin (); i != Blocks.end (); ++i) {
+      for (size_t j = 0; j < i->second.size (); j++)
+         FreeAligned (i->second [j]);
+   }
+
+   Blocks.clear ();
+
+   Cached = 0;
+
+   return true;
+}
+
+size_t GenomePool::GetCached () const {
+   return Cached;
+}
+
+//
+// MutationCursor implementation
+//
+
+MutationCursor::MutationCursor () {
+   Chance  = -1.0F;
+   LogMiss = 0.0;
+   Gap     = 0;
+}
+
+bool MutationCursor::Reset (float C, Generator &Rng) {
+   Chance = C;
+
+   if (Chance > 0.0F && Chance < 1.0F)
+      LogMiss = log (1.0 - Chance);
+
+   // Geometric gaps are memoryless, so starting over is exact:
+   Gap = Draw (Rng);
+
+   return true;
+}
+
+long long MutationCursor::Draw (Generator &Rng) const {
+   // Never / always:
+   if (Chance <= 0.0F)
+      return 1LL << 62;
+
+   if (Chance >= 1.0F)
+      return 0;
+
+   // Misses before the next hit, P (k) = (1 - Chance)^k * Chance:
+   double U = 1.0 - Rng.Random ();
+
+   double k = floor (log (U) / LogMiss);
+
+   if (k > (double) (1LL << 62))
+      return 1LL << 62;
+
+   return (long long) k;
 }
 
 //
 // Gene implementation
 //
 
+// Bytes in front of an owned gene's data, holding the count of genes that
+// share it:
+#define ADAPTAI_SHARED_HEADER 16
+
+static float *AllocateShared (int Length) {
+   if (Length <= 0)
+      return NULL;
+
+   char *Raw = new char [ADAPTAI_SHARED_HEADER + sizeof (float) * Length];
+
+   new (Raw) std::atomic<int> (1);
+
+   return (float *) (Raw + ADAPTAI_SHARED_HEADER);
+}
+
+static std::atomic<int> *SharedCount (const float *Sequence) {
+   return (std::atomic<int> *) ((char *) Sequence - ADAPTAI_SHARED_HEADER);
+}
+
+static void ReleaseShared (float *Sequence) {
+   if (Sequence == NULL)
+      return;
+
+   std::atomic<int> *Count = SharedCount (Sequence);
+
+   // Last one out frees it:
+   if (Count->fetch_sub (1, std::memory_order_acq_rel) == 1) {
+      Count->~atomic ();
+
+      delete [] ((char *) Sequence - ADAPTAI_SHARED_HEADER);
+   }
+}
+
 Gene::Gene () {
    Sequence = NULL;
 
@@ -29,18 +200,98 @@ Gene::Gene () {
    MutationRate   = ADAPTAI_DEFAULTRATE;
 
    SequenceLength = 0;
+
+   View  = false;
+   Storage = NULL;
 }
 
 Gene::Gene (const Gene &Gene) {
+   Sequence       = NULL;
+   SequenceLength = 0;
+   View           = false;
+   Storage          = NULL;
+
    (*this) = Gene;
 }
 
+Gene::Gene (Gene &&G) {
+   Sequence       = NULL;
+   SequenceLength = 0;
+   View           = false;
+   Storage          = NULL;
+
+   (*this) = std::move (G);
+}
+
 Gene::~Gene () {
-   delete [] Sequence;
+   if (!View)
+      ReleaseShared (Sequence);
+}
+
+bool Gene::Bind (float *Buffer, int Length) {
+   if (Buffer == NULL || Length < 0)
+      return false;
+
+   if (!View)
+      ReleaseShared (Sequence);
+
+   // The buffer's contents are left untouched:
+   Sequence       = Buffer;
+   SequenceLength = Length;
+
+   View = true;
+
+   return true;
+}
+
+bool Gene::Detach () {
+   if (!View)
+      return true;
+
+   float *Copy = AllocateShared (SequenceLength);
+
+   for (int i = 0; i < SequenceLength; i++)
+      Copy [i] = Sequence [i];
+
+   Sequence = Copy;
+
+   View  = false;
+   Storage = NULL;
+
+   return true;
+}
+
+bool Gene::Own () {
+   // A view's data is its genome's, which copies all of it at once:
+   if (View)
+      return Storage == NULL || Storage->Own ();
+
+   if (Sequence == NULL || SharedCount (Sequence)->load (std::memory_order_acquire) == 1)
+      return true;
+
+   float *Copy = AllocateShared (SequenceLength);
+
+   memcpy (Copy, Sequence, sizeof (float) * SequenceLength);
+
+   ReleaseShared (Sequence);
+
+   Sequence = Copy;
+
+   return true;
+}
+
+bool Gene::IsView () const {
+   return View;
+}
+
+bool Gene::IsShared () const {
+   return !View && Sequence != NULL && SharedCount (Sequence)->load (std::memory_order_acquire) > 1;
 }
 
 bool Gene::SetElement (int i, float El) {
    if (i >= 0 && i < SequenceLength) {
+      Own ();
+
       Sequence [i] = El;
 
       return true;
@@ -58,11 +309,24 @@ float Gene::GetElement (int i) const {
 }
 
 bool Gene::SetLength (int Length) {
-   delete [] Sequence;
+   if (View) {
+      // A view's shape belongs to its owner; only clear it:
+      if (Length != SequenceLength)
+         return false;
+
+      Own ();
+
+      for (int i = 0; i < SequenceLength; i++)
+         Sequence [i] = 0.0F;
+
+      return true;
+   }
+
+   ReleaseShared (Sequence);
 
    SequenceLength = Length;
 
-   Sequence = new float [SequenceLength];
+   Sequence = AllocateShared (SequenceLength);
 
    // Initialize to zero:
    for (int i = 0; i < SequenceLength; i++)
@@ -102,38 +366,111 @@ float Gene::GetMutationRate () const {
 }
 
 bool Gene::Mutate () {
+   return Mutate (GetGenerator ());
+}
+
+bool Gene::Mutate (Generator &Rng) {
+   MutationCursor Cursor;
+
+   return Mutate (Rng, Cursor);
+}
+
+bool Gene::Mutate (Generator &Rng, MutationCursor &Cursor) {
    if (SequenceLength <= 0)
       return false;
 
-   for (int i = 0; i < SequenceLength; i++) {
-      if (Random () <= MutationChance)
-         Sequence [i] = Sequence [i] + (2.0F * Random () - 1.0F) * MutationRate;
+   if (Cursor.Chance != MutationChance)
+      Cursor.Reset (MutationChance, Rng);
+
+   // Each element still mutates with probability MutationChance, but only
+   // the elements that do are visited:
+   long long i = Cursor.Gap;
+
+   // Shared data is copied only when a mutation actually lands in it:
+   if (i < SequenceLength)
+      Own ();
+
+   while (i < SequenceLength) {
+      Sequence [i] = Sequence [i] + (2.0F * Rng.Random () - 1.0F) * MutationRate;
+
+      i += 1 + Cursor.Draw (Rng);
    }
 
+   Cursor.Gap = i - SequenceLength;
+
    return true;
 }
 
 bool Gene::MutateMutationFactors (float Chance, float Rate) {
-   if (Random () <= Chance) {
-      MutationChance += (Random () * 2.0F - 1.0F) * Rate;
-      MutationRate   += (Random () * 2.0F - 1.0F) * Rate;
+   return MutateMutationFactors (Chance, Rate, GetGenerator ());
+}
+
+bool Gene::MutateMutationFactors (float Chance, float Rate, Generator &Rng) {
+   if (Rng.Random () <= Chance) {
+      MutationChance += (Rng.Random () * 2.0F - 1.0F) * Rate;
+      MutationRate   += (Rng.Random () * 2.0F - 1.0F) * Rate;
    }
 
    return true;
 }
 
 Gene &Gene::operator = (const Gene &G) {
-   SetLength (G.SequenceLength);
+   if (this == &G)
+      return *this;
 
    MutationChance = G.MutationChance;
    MutationRate   = G.MutationRate;
 
+   if (View) {
+      Own ();
+
+      // Views keep their shape; copy the overlapping elements:
+      for (int i = 0; i < SequenceLength; i++)
+         Sequence [i] = (i < G.SequenceLength) ? G.Sequence [i] : 0.0F;
+
+      return *this;
+   }
+
+   // An owned buffer is shared rather than copied, until one side writes:
+   if (!G.View) {
+      if (Sequence == G.Sequence)
+         return *this;
+
+      if (G.Sequence != NULL)
+         SharedCount (G.Sequence)->fetch_add (1, std::memory_order_relaxed);
+
+      ReleaseShared (Sequence);
+
+      Sequence       = G.Sequence;
+      SequenceLength = G.SequenceLength;
+
+      return *this;
+   }
+
+   // Same length, same buffer if it's ours alone:
+   if (SequenceLength != G.SequenceLength || IsShared ())
+      SetLength (G.SequenceLength);
+
    for (int i = 0; i < SequenceLength; i++)
       Sequence [i] = G.Sequence [i];
 
    return *this;
 }
 
+Gene &Gene::operator = (Gene &&G) {
+   // Views never change hands, they copy:
+   if (this == &G || View || G.View)
+      return (*this) = (const Gene &) G;
+
+   MutationChance = G.MutationChance;
+   MutationRate   = G.MutationRate;
+
+   std::swap (Sequence, G.Sequence);
+   std::swap (SequenceLength, G.SequenceLength);
+
+   return *this;
+}
+
 Gene Gene::operator + (const Gene &G) const {
    Gene NewG;
 
@@ -150,6 +487,29 @@ Gene Gene::operator + (const Gene &G) const {
    return NewG;
 }
 
+bool Gene::Average (const Gene &A, const Gene &B) {
+   if (A.SequenceLength != B.SequenceLength) {
+      (*this) = Gene ();
+
+      return false;
+   }
+
+   // Like operator +, the result has default mutation factors:
+   MutationChance = ADAPTAI_DEFAULTCHANCE;
+   MutationRate   = ADAPTAI_DEFAULTRATE;
+
+   if (SequenceLength != A.SequenceLength && !SetLength (A.SequenceLength))
+      return false;
+
+   // This gene may be A or B, so a shared buffer is copied, not dropped:
+   Own ();
+
+   for (int i = 0; i < SequenceLength; i++)
+      Sequence [i] = (A.Sequence [i] + B.Sequence [i]) / 2.0F;
+
+   return true;
+}
+
 bool Gene::Save (std::fstream &File) const {
    // File Format:
    //          SequenceLength       sizeof (int)
@@ -168,11 +528,13 @@ bool Gene::Save (std::fstream &File) const {
 }
 
 bool Gene::Load (std::fstream &File) {
-   File.read ((char *) &SequenceLength, sizeof (int));
+   int Length = 0;
+
+   File.read ((char *) &Length,         sizeof (int));
    File.read ((char *) &MutationChance, sizeof (float));
    File.read ((char *) &MutationRate,   sizeof (float));
 
-   if (!SetLength (SequenceLength))
+   if (!File.good () || !SetLength (Length))
       return false;
 
    File.read ((char *) Sequence, sizeof (float) * SequenceLength);
@@ -195,14 +557,30 @@ Chromosome::Chromosome () {
    Crossover = true;
 
    CrossoverMutationChance = ADAPTAI_DEFAULTCHANCE;
+
+   Bound = false;
 }
 
 Chromosome::Chromosome (const Chromosome &Chrom) {
+   GeneList  = NULL;
+   GeneCount = 0;
+   Bound     = false;
+
    (*this) = Chrom;
 }
 
+Chromosome::Chromosome (Chromosome &&Chrom) {
+   GeneList  = NULL;
+   GeneCount = 0;
+   Bound     = false;
+
+   (*this) = std::move (Chrom);
+}
+
 Chromosome::~Chromosome () {
-   delete [] GeneList;
+   // Bound genes belong to the genome's block:
+   if (!Bound)
+      delete [] GeneList;
 }
 
 bool Chromosome::SetGene (int i, const Gene &G) {
@@ -222,10 +600,63 @@ Gene &Chromosome::GetGene (int i) const {
    return *(&GeneList [i]);
 }
 
+bool Chromosome::Bind (Gene *Genes, float *Buffer, int Count, int Length) {
+   if (Genes == NULL || Buffer == NULL || Count < 0 || Length < 0)
+      return false;
+
+   if (!Bound)
+      delete [] GeneList;
+
+   GeneList  = Genes;
+   GeneCount = Count;
+
+   for (int i = 0; i < GeneCount; i++)
+      GeneList [i].Bind (Buffer + i * Length, Length);
+
+   Bound = true;
+
+   return true;
+}
+
+bool Chromosome::Detach () {
+   if (!Bound)
+      return true;
+
+   // The block's genes are left for the genome to destroy:
+   Gene *Copy = new Gene [GeneCount];
+
+   for (int i = 0; i < GeneCount; i++)
+      Copy [i] = GeneList [i];
+
+   GeneList = Copy;
+
+   Bound = false;
+
+   return true;
+}
+
+bool Chromosome::IsBound () const {
+   return Bound;
+}
+
 bool Chromosome::SetGeneCount (int Length) {
    if (Length < 0)
       return false;
 
+   if (Bound) {
+      // The owning genome fixes the gene count; reset the genes in place:
+      if (Length != GeneCount)
+         return false;
+
+      for (int i = 0; i < GeneCount; i++) {
+         GeneList [i].SetLength (GeneList [i].GetLength ());
+         GeneList [i].SetMutationChance (ADAPTAI_DEFAULTCHANCE);
+         GeneList [i].SetMutationRate (ADAPTAI_DEFAULTRATE);
+      }
+
+      return true;
+   }
+
    delete [] GeneList;
 
    GeneCount = Length;
@@ -240,11 +671,27 @@ int Chromosome::GetGeneCount () const {
 }
 
 Chromosome &Chromosome::operator = (const Chromosome &Chrom) {
-   SetGeneCount (Chrom.GeneCount);
+   if (this == &Chrom)
+      return *this;
 
    Crossover               = Chrom.Crossover;
    CrossoverMutationChance = Chrom.CrossoverMutationChance;
 
+   if (Bound) {
+      // Bound genes are written in place, overlapping genes only:
+      for (int i = 0; i < GeneCount; i++) {
+         if (i < Chrom.GeneCount)
+            GeneList [i] = Chrom.GeneList [i];
+         else GeneList [i] = Gene ();
+      }
+
+      return *this;
+   }
+
+   // Same count, same genes; each gene keeps its own buffer:
+   if (GeneCount != Chrom.GeneCount)
+      SetGeneCount (Chrom.GeneCount);
+
    // Copy gene info:
    for (int i = 0; i < GeneCount; i++) {
       GeneList [i] = Chrom.GeneList [i];
@@ -253,48 +700,80 @@ Chromosome &Chromosome::operator = (const Chromosome &Chrom) {
    return *this;
 }
 
+Chromosome &Chromosome::operator = (Chromosome &&Chrom) {
+   // Bound genes belong to a genome's block, so they copy:
+   if (this == &Chrom || Bound || Chrom.Bound)
+      return (*this) = (const Chromosome &) Chrom;
+
+   Crossover               = Chrom.Crossover;
+   CrossoverMutationChance = Chrom.CrossoverMutationChance;
+
+   std::swap (GeneList, Chrom.GeneList);
+   std::swap (GeneCount, Chrom.GeneCount);
+
+   return *this;
+}
+
 Chromosome Chromosome::operator + (const Chromosome &Chrom) const {
+   return Cross (Chrom, GetGenerator ());
+}
+
+Chromosome Chromosome::Cross (const Chromosome &Chrom, Generator &Rng) const {
    Chromosome Temp;
 
-   if (GeneCount != Chrom.GeneCount)
-      return Temp;
+   Cross (Chrom, Temp, Rng);
+
+   return Temp;
+}
+
+bool Chromosome::Cross (const Chromosome &Chrom, Chromosome &Child, Generator &Rng) const {
+   if (GeneCount != Chrom.GeneCount) {
+      Child = Chromosome ();
+
+      return false;
+   }
+
+   if (Child.GeneCount != GeneCount && !Child.SetGeneCount (GeneCount))
+      return false;
 
-   Temp.SetGeneCount (GeneCount);
+   // Child may be either parent, so read the parents' traits up front:
+   bool  Cross1  = Crossover,               Cross2  = Chrom.Crossover;
+   float Chance1 = CrossoverMutationChance, Chance2 = Chrom.CrossoverMutationChance;
 
    if (Crossover) {
       // 50% chance of inheriting crossover trait & mutation rate from either parent:
-      if (Random () < 0.5F) {
-         Temp.Crossover               = Crossover;
-         Temp.CrossoverMutationChance = CrossoverMutationChance;
+      if (Rng.Random () < 0.5F) {
+         Child.Crossover               = Cross1;
+         Child.CrossoverMutationChance = Chance1;
       }
       else {
-         Temp.Crossover               = Chrom.Crossover;
-         Temp.CrossoverMutationChance = Chrom.CrossoverMutationChance;
+         Child.Crossover               = Cross2;
+         Child.CrossoverMutationChance = Chance2;
       }
 
       for (int i = 0; i < GeneCount; i++) {
          // 50% chance of inheriting gene from either parent:
-         if (Random () < 0.5F)
-            Temp.GeneList [i] = GeneList [i];
-         else Temp.GeneList [i] = Chrom.GeneList [i];
+         if (Rng.Random () < 0.5F)
+            Child.GeneList [i] = GeneList [i];
+         else Child.GeneList [i] = Chrom.GeneList [i];
       } 
    }
    else {
       // 50% chance of inheriting crossover trait from either parent:
-      if (Random () < 0.5F)
-         Temp.Crossover = Crossover;
-      else Temp.Crossover = Chrom.Crossover;
+      if (Rng.Random () < 0.5F)
+         Child.Crossover = Cross1;
+      else Child.Crossover = Cross2;
 
       // Mutation chance is numerical average of parents:
-      Temp.CrossoverMutationChance = (CrossoverMutationChance + Chrom.CrossoverMutationChance) / 2.0F;
+      Child.CrossoverMutationChance = (Chance1 + Chance2) / 2.0F;
 
       // Genes are numerical average of parents:
       for (int i = 0; i < GeneCount; i++) {
-         Temp.GeneList [i] = GeneList [i] + Chrom.GeneList [i];
+         Child.GeneList [i].Average (GeneList [i], Chrom.GeneList [i]);
       } 
    }
 
-   return Temp;
+   return true;
 }
 
 bool Chromosome::SetCrossoverState (bool State) {
@@ -324,7 +803,11 @@ float Chromosome::GetCrossoverMutationChance () {
 }
 
 bool Chromosome::MutateChromosome () {
-   if (Random () <= CrossoverMutationChance) {
+   return MutateChromosome (GetGenerator ());
+}
+
+bool Chromosome::MutateChromosome (Generator &Rng) {
+   if (Rng.Random () <= CrossoverMutationChance) {
       if (Crossover) {
          Crossover = false;
       }
@@ -337,23 +820,41 @@ bool Chromosome::MutateChromosome () {
 }
 
 bool Chromosome::MutateGenes () {
+   return MutateGenes (GetGenerator ());
+}
+
+bool Chromosome::MutateGenes (Generator &Rng) {
+   MutationCursor Cursor;
+
+   return MutateGenes (Rng, Cursor);
+}
+
+bool Chromosome::MutateGenes (Generator &Rng, MutationCursor &Cursor) {
    for (int i = 0; i < GeneCount; i++)
-      GeneList [i].Mutate ();
+      GeneList [i].Mutate (Rng, Cursor);
 
    return true;
 }
 
 bool Chromosome::Mutate () {
-   return (MutateChromosome () && MutateGenes ());
+   return Mutate (GetGenerator ());
+}
+
+bool Chromosome::Mutate (Generator &Rng) {
+   return (MutateChromosome (Rng) && MutateGenes (Rng));
 }
 
 bool Chromosome::MutateMutationFactors (float Chance, float Rate) {
-   if (Random () <= Chance) {
-      SetCrossoverMutationChance (CrossoverMutationChance + (Random () * 2.0F - 1.0F) * Rate);
+   return MutateMutationFactors (Chance, Rate, GetGenerator ());
+}
+
+bool Chromosome::MutateMutationFactors (float Chance, float Rate, Generator &Rng) {
+   if (Rng.Random () <= Chance) {
+      SetCrossoverMutationChance (CrossoverMutationChance + (Rng.Random () * 2.0F - 1.0F) * Rate);
    }
 
    for (int i = 0; i < GeneCount; i++) {
-      GeneList [i].MutateMutationFactors (Chance, Rate);
+      GeneList [i].MutateMutationFactors (Chance, Rate, Rng);
    }
 
    return true;
@@ -368,7 +869,7 @@ bool Chromosome::Save (std::fstream &File) const {
 
    File.write ((const char *) &GeneCount, sizeof (int));
    File.write ((const char *) &Crossover, sizeof (bool));
-   File.write ((const char *) &CrossoverMutationChance, sizeof (bool));
+   File.write ((const char *) &CrossoverMutationChance, sizeof (float));
 
    for (int i = 0; i < GeneCount; i++)
       GeneList [i].Save (File);
@@ -380,11 +881,14 @@ bool Chromosome::Save (std::fstream &File) const {
 }
 
 bool Chromosome::Load (std::fstream &File) {
-   File.read ((char *) &GeneCount, sizeof (int));
+   int Count = 0;
+
+   File.read ((char *) &Count, sizeof (int));
    File.read ((char *) &Crossover, sizeof (bool));
    File.read ((char *) &CrossoverMutationChance, sizeof (float));
 
-   SetGeneCount (GeneCount);
+   if (!File.good () || !SetGeneCount (Count))
+      return false;
 
    for (int i = 0; i < GeneCount; i++)
       GeneList [i].Load (File);
@@ -396,93 +900,852 @@ bool Chromosome::Load (std::fstream &File) {
 }
 
 //
-// Genome implementation
+// GenomeData implementation
 //
 
-Genome::Genome () {
+// Bytes in front of a contiguous genome's data, holding the count of
+// genomes that share it and where it goes back to. A whole alignment unit,
+// so the data after it stays aligned:
+#define ADAPTAI_DATA_HEADER ADAPTAI_ALIGNMENT
+
+class DataHeader {
+   public:
+      std::atomic<int> Count;
+
+      GenomePool *Owner;
+      size_t     Size;
+};
+
+static DataHeader *DataInfo (const float *Data) {
+   return (DataHeader *) ((char *) Data - ADAPTAI_DATA_HEADER);
+}
+
+static float *AllocateData (GenomePool *Pool, size_t Floats) {
+   size_t Size = Floats + ADAPTAI_DATA_HEADER / sizeof (float);
+
+   float *Raw = (Pool != NULL) ? Pool->Allocate (Size) : AllocateAligned (Size);
+
+   DataHeader *Info = new (Raw) DataHeader;
+
+   Info->Count.store (1, std::memory_order_relaxed);
+
+   Info->Owner = Pool;
+   Info->Size  = Size;
+
+   return (float *) ((char *) Raw + ADAPTAI_DATA_HEADER);
+}
+
+static void ReleaseData (float *Data) {
+   if (Data == NULL)
+      return;
+
+   DataHeader *Info = DataInfo (Data);
+
+   // Last one out returns it:
+   if (Info->Count.fetch_sub (1, std::memory_order_acq_rel) == 1) {
+      GenomePool *Owner = Info->Owner;
+      size_t     Size   = Info->Size;
+
+      Info->~DataHeader ();
+
+      if (Owner != NULL)
+         Owner->Release ((float *) Info, Size);
+      else FreeAligned ((float *) Info);
+   }
+}
+
+bool GenomeData::Rebind (float *To) {
+   for (int i = 0; i < GeneCount; i++)
+      GeneList [i].Sequence = To + (GeneList [i].Sequence - Data);
+
+   ReleaseData (Data);
+
+   Data = To;
+
+   return true;
+}
+
+bool GenomeData::Own (bool Keep) {
+   if (Data == NULL || DataInfo (Data)->Count.load (std::memory_order_acquire) == 1)
+      return true;
+
+   float *Copy = AllocateData (Pool, Floats);
+
+   if (Keep)
+      memcpy (Copy, Data, sizeof (float) * Floats);
+
+   return Rebind (Copy);
+}
+
+bool GenomeData::Share (float *Shared) {
+   if (Shared == Data)
+      return true;
+
+   DataInfo (Shared)->Count.fetch_add (1, std::memory_order_relaxed);
+
+   return Rebind (Shared);
+}
+
+//
+// Genome implementation
+//
+
+Genome::Genome () {
    ChromosomeList  = NULL;
    ChromosomeCount = 0;
+
+   Contiguous = false;
+   Storage      = NULL;
+   DataGenes  = DataLength = 0;
+
+   Block      = NULL;
+   BlockSize  = 0;
+   Pool       = BlockOwner = NULL;
+
+   Hash   = 0;
+   Hashed = false;
 }
 
 Genome::Genome (const Genome &G) {
+   ChromosomeList  = NULL;
+   ChromosomeCount = 0;
+
+   Contiguous = false;
+   Storage      = NULL;
+   DataGenes  = DataLength = 0;
+
+   Block      = NULL;
+   BlockSize  = 0;
+   Pool       = BlockOwner = NULL;
+
+   Hash   = 0;
+   Hashed = false;
+
    (*this) = G;
 }
 
-Genome::~Genome () {
-   delete [] ChromosomeList;
-}
+Genome::Genome (Genome &&G) noexcept {
+   ChromosomeList  = NULL;
+   ChromosomeCount = 0;
+
+   Storage      = NULL;
+   DataGenes  = DataLength = 0;
+
+   Block      = NULL;
+   BlockSize  = 0;
+   BlockOwner = NULL;
+
+   Hash   = 0;
+   Hashed = false;
+
+   // A new genome takes everything, pool included:
+   Contiguous = G.Contiguous;
+   Pool       = G.Pool;
+
+   Swap (G);
+}
+
+Genome::~Genome () {
+   Release ();
+}
+
+// Hash term key past any element pair, for a gene's mutation factors:
+#define ADAPTAI_HASH_FACTORS 0xFFFFFFFFU
+
+// A genome's hash is the sum of one term per value, or per pair of gene
+// elements, each mixed with its place. Changing a value costs one term out
+// and one term in:
+static inline unsigned long long HashMix (unsigned long long x) {
+   x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+   return x ^ (x >> 31);
+}
+
+// Seed for gene j of chromosome i and its length, j = -1 for the
+// chromosome's own traits:
+static inline unsigned long long HashBase (int i, int j, int Length = 0) {
+   return HashMix (((unsigned long long) (unsigned int) i << 32 | (unsigned int) j) + 0x9E3779B97F4A7C15ULL * (1 + (unsigned int) Length));
+}
+
+static inline unsigned long long HashTerm (unsigned long long Base, unsigned int Key, unsigned long long Value) {
+   return HashMix ((Base + Key * 0x9E3779B97F4A7C15ULL) ^ Value);
+}
+
+static inline unsigned long long HashTerm (unsigned long long Base, unsigned int Key, float Value) {
+   unsigned int Bits;
+
+   memcpy (&Bits, &Value, sizeof (float));
+
+   return HashTerm (Base, Key, (unsigned long long) Bits);
+}
+
+static inline unsigned long long HashFactors (unsigned long long Base, float Chance, float Rate) {
+   unsigned int Low, High;
+
+   memcpy (&Low,  &Chance, sizeof (float));
+   memcpy (&High, &Rate,   sizeof (float));
+
+   return HashTerm (Base, ADAPTAI_HASH_FACTORS, (unsigned long long) High << 32 | Low);
+}
+
+// Elements 2p and 2p + 1 of a gene, the second one 0 past the end:
+static inline unsigned long long HashPair (unsigned long long Base, const float *Sequence, int Length, int p) {
+   unsigned int Low, High = 0;
+
+   memcpy (&Low, &Sequence [2 * p], sizeof (float));
+
+   if (2 * p + 1 < Length)
+      memcpy (&High, &Sequence [2 * p + 1], sizeof (float));
+
+   return HashTerm (Base, (unsigned int) p, (unsigned long long) High << 32 | Low);
+}
+
+// Gene tags in a genome delta:
+#define ADAPTAI_DELTA_BASE       0
+#define ADAPTAI_DELTA_MATE       1
+#define ADAPTAI_DELTA_PATCH      2
+#define ADAPTAI_DELTA_PATCH_MATE 3
+#define ADAPTAI_DELTA_LITERAL    4
+
+static void Append (std::vector<char> &Out, const void *Data, size_t Size) {
+   const char *Bytes = (const char *) Data;
+
+   Out.insert (Out.end (), Bytes, Bytes + Size);
+}
+
+static size_t RoundBlock (size_t Bytes) {
+   return (Bytes + ADAPTAI_ALIGNMENT - 1) & ~((size_t) ADAPTAI_ALIGNMENT - 1);
+}
+
+bool Genome::Build (int Count, int Genes, int Length) {
+   if (ChromosomeList != NULL || Count * Genes * Length == 0)
+      return false;
+
+   int i, RowSize = Genes * Length;
+
+   // Layout: [GenomeData][Chromosome x Count][Gene x Count * Genes], the
+   // Count x RowSize data is allocated on its own so copies can share it:
+   size_t StoreBytes = RoundBlock (sizeof (GenomeData));
+   size_t ChromBytes = RoundBlock (sizeof (Chromosome) * Count);
+   size_t GeneBytes  = RoundBlock (sizeof (Gene) * Count * Genes);
+
+   BlockSize  = (StoreBytes + ChromBytes + GeneBytes) / sizeof (float);
+   BlockOwner = Pool;
+
+   Block = (BlockOwner != NULL) ? BlockOwner->Allocate (BlockSize) : AllocateAligned (BlockSize);
+
+   char *Base = (char *) Block;
+
+   Storage          = new (Base) GenomeData;
+   ChromosomeList = (Chromosome *) (Base + StoreBytes);
+   Gene *GeneList = (Gene *) (Base + StoreBytes + ChromBytes);
+
+   Storage->Floats    = (size_t) Count * RowSize;
+   Storage->GeneList  = GeneList;
+   Storage->GeneCount = Count * Genes;
+   Storage->Pool      = BlockOwner;
+   Storage->Data      = AllocateData (BlockOwner, Storage->Floats);
+
+   float *Data = Storage->Data;
+
+   memset (Data, 0, sizeof (float) * Storage->Floats);
+
+   for (i = 0; i < Count * Genes; i++)
+      new (GeneList + i) Gene;
+
+   for (i = 0; i < Count; i++) {
+      new (ChromosomeList + i) Chromosome;
+
+      ChromosomeList [i].Bind (GeneList + i * Genes, Data + i * RowSize, Genes, Length);
+   }
+
+   for (i = 0; i < Count * Genes; i++)
+      GeneList [i].Storage = Storage;
+
+   ChromosomeCount = Count;
+   DataGenes       = Genes;
+   DataLength      = Length;
+
+   return true;
+}
+
+bool Genome::Release () {
+   if (Block != NULL) {
+      int i;
+
+      for (i = 0; i < ChromosomeCount; i++)
+         ChromosomeList [i].~Chromosome ();
+
+      for (i = 0; i < Storage->GeneCount; i++)
+         Storage->GeneList [i].~Gene ();
+
+      ReleaseData (Storage->Data);
+
+      Storage->~GenomeData ();
+
+      if (BlockOwner != NULL)
+         BlockOwner->Release (Block, BlockSize);
+      else FreeAligned (Block);
+   }
+   else delete [] ChromosomeList;
+
+   ChromosomeList  = NULL;
+   ChromosomeCount = 0;
+
+   Storage      = NULL;
+   DataGenes  = DataLength = 0;
+
+   Block      = NULL;
+   BlockSize  = 0;
+   BlockOwner = NULL;
+
+   Hashed = false;
+
+   return true;
+}
+
+void Genome::Swap (Genome &G) {
+   // Storage only; each side keeps its own mode and pool:
+   std::swap (ChromosomeList, G.ChromosomeList);
+   std::swap (ChromosomeCount, G.ChromosomeCount);
+
+   std::swap (Storage, G.Storage);
+   std::swap (DataGenes, G.DataGenes);
+   std::swap (DataLength, G.DataLength);
+
+   std::swap (Block, G.Block);
+   std::swap (BlockSize, G.BlockSize);
+   std::swap (BlockOwner, G.BlockOwner);
+
+   // The hash describes the storage's content, so it goes along:
+   std::swap (Hash, G.Hash);
+   std::swap (Hashed, G.Hashed);
+}
+
+bool Genome::Pack () {
+   if (Storage != NULL || ChromosomeCount == 0)
+      return true;
+
+   int i, j;
+
+   int Genes  = ChromosomeList [0].GetGeneCount ();
+   int Length = (Genes > 0) ? ChromosomeList [0].GetGene (0).GetLength () : 0;
+
+   // Only uniformly shaped genomes fit in one block:
+   for (i = 0; i < ChromosomeCount; i++) {
+      if (ChromosomeList [i].GetGeneCount () != Genes)
+         return false;
+
+      for (j = 0; j < Genes; j++) {
+         if (ChromosomeList [i].GetGene (j).GetLength () != Length)
+            return false;
+      }
+   }
+
+   if (Genes * Length == 0)
+      return true;
+
+   Genome Temp;
+
+   Temp.Pool = Pool;
+
+   Temp.Build (ChromosomeCount, Genes, Length);
+
+   for (i = 0; i < ChromosomeCount; i++)
+      Temp.ChromosomeList [i] = ChromosomeList [i];
+
+   Swap (Temp);
+
+   return true;
+}
+
+bool Genome::Unpack () {
+   if (Storage == NULL)
+      return true;
+
+   int Count = ChromosomeCount;
+
+   Chromosome *List = new Chromosome [Count];
+
+   for (int i = 0; i < Count; i++)
+      List [i] = ChromosomeList [i];
+
+   Release ();
+
+   ChromosomeList  = List;
+   ChromosomeCount = Count;
+
+   return true;
+}
+
+bool Genome::SetShape (int Count, int Genes, int Length) {
+   if (Count < 0 || Genes < 0 || Length < 0)
+      return false;
+
+   Hashed = false;
+
+   int i, j;
+
+   int RowSize = Genes * Length;
+
+   if (!Contiguous || Count * RowSize == 0) {
+      Unpack ();
+
+      if (Count != ChromosomeCount)
+         SetChromosomeCount (Count);
+
+      for (i = 0; i < ChromosomeCount; i++) {
+         Chromosome &Chrom = ChromosomeList [i];
+
+         if (Chrom.GetGeneCount () != Genes)
+            Chrom.SetGeneCount (Genes);
+
+         for (j = 0; j < Genes; j++)
+            Chrom.GetGene (j).SetLength (Length);
+      }
+
+      return true;
+   }
+
+   // Same shape, zero the coefficients and keep the factors:
+   if (Storage != NULL && Count == ChromosomeCount && Genes == DataGenes && Length == DataLength) {
+      Storage->Own (false);
+
+      memset (Storage->Data, 0, sizeof (float) * Count * RowSize);
+
+      return true;
+   }
+
+   Genome Temp;
+
+   Temp.Pool = Pool;
+
+   Temp.Build (Count, Genes, Length);
+
+   // Surviving chromosomes and genes keep their traits and mutation factors:
+   if (Count == ChromosomeCount) {
+      for (i = 0; i < Count; i++) {
+         Chromosome &From = ChromosomeList [i];
+         Chromosome &To   = Temp.ChromosomeList [i];
+
+         To.Crossover               = From.Crossover;
+         To.CrossoverMutationChance = From.CrossoverMutationChance;
+
+         if (From.GeneCount != Genes)
+            continue;
+
+         for (j = 0; j < Genes; j++) {
+            To.GeneList [j].MutationChance = From.GeneList [j].MutationChance;
+            To.GeneList [j].MutationRate   = From.GeneList [j].MutationRate;
+         }
+      }
+   }
+
+   Swap (Temp);
+
+   return true;
+}
+
+bool Genome::SetContiguous (bool State) {
+   if (!State) {
+      Contiguous = false;
+
+      return Unpack ();
+   }
+
+   if (!Pack ())
+      return false;
+
+   Contiguous = true;
+
+   return true;
+}
+
+bool Genome::GetContiguous () const {
+   return Contiguous;
+}
+
+bool Genome::SetPool (GenomePool *P) {
+   // Only later blocks come from P, the current one still returns home:
+   Pool = P;
+
+   return true;
+}
+
+GenomePool *Genome::GetPool () const {
+   return Pool;
+}
+
+float *Genome::GetData () {
+   if (Storage == NULL)
+      return NULL;
+
+   // The caller may write through it:
+   Storage->Own ();
+
+   Hashed = false;
+
+   return Storage->Data;
+}
+
+const float *Genome::GetData () const {
+   return (Storage != NULL) ? Storage->Data : NULL;
+}
+
+bool Genome::SetChromosome (int i, const Chromosome &Chrom) {
+   if (i < 0 || i >= ChromosomeCount)
+      return false;
+
+   ChromosomeList [i] = Chrom;
+
+   Hashed = false;
+
+   return true;
+}
+
+Chromosome &Genome::GetChromosome (int i) const {
+   if (i < 0 || i >= ChromosomeCount) {
+      throw;
+   }
+
+   return *(&ChromosomeList [i]);
+}
+
+bool Genome::SetChromosomeCount (int Count) {
+   if (Count < 0)
+      return false;
+
+   // Fresh chromosomes own their genes again:
+   Release ();
+
+   ChromosomeCount = Count;
+
+   ChromosomeList = new Chromosome [ChromosomeCount];
+
+   return true;   
+}
+
+int Genome::GetChromosomeCount () const {
+   return ChromosomeCount;
+}
+
+Genome &Genome::operator = (const Genome &G) {
+   if (this == &G)
+      return *this;
+
+   int i, j;
+
+   // The pool stays ours, a copy may outlive the source's:
+   Contiguous = G.Contiguous;
+
+   if (G.Storage == NULL) {
+      if (Storage != NULL || ChromosomeCount != G.ChromosomeCount)
+         SetChromosomeCount (G.ChromosomeCount);
+
+      for (i = 0; i < ChromosomeCount; i++)
+         ChromosomeList [i] = G.ChromosomeList [i];
+
+      Hash   = G.Hash;
+      Hashed = G.Hashed;
+
+      return *this;
+   }
+
+   // Keep our block when the shapes already match:
+   if (Storage == NULL || ChromosomeCount != G.ChromosomeCount || DataGenes != G.DataGenes || DataLength != G.DataLength) {
+      Release ();
+
+      Build (G.ChromosomeCount, G.DataGenes, G.DataLength);
+   }
+
+   // Share the data if it goes back to a pool we may hold on to anyway,
+   // otherwise copy it:
+   GenomePool *Owner = DataInfo (G.Storage->Data)->Owner;
+
+   if (Owner == Pool || Owner == BlockOwner)
+      Storage->Share (G.Storage->Data);
+   else {
+      Storage->Own (false);
+
+      memcpy (Storage->Data, G.Storage->Data, sizeof (float) * Storage->Floats);
+   }
+
+   for (i = 0; i < ChromosomeCount; i++) {
+      Chromosome &From = G.ChromosomeList [i];
+      Chromosome &To   = ChromosomeList [i];
+
+      To.Crossover               = From.Crossover;
+      To.CrossoverMutationChance = From.CrossoverMutationChance;
+
+      for (j = 0; j < DataGenes; j++) {
+         To.GeneList [j].MutationChance = From.GeneList [j].MutationChance;
+         To.GeneList [j].MutationRate   = From.GeneList [j].MutationRate;
+      }
+   }
+
+   Hash   = G.Hash;
+   Hashed = G.Hashed;
+
+   return *this;
+}
+
+Genome &Genome::operator = (Genome &&G) {
+   if (this == &G)
+      return *this;
+
+   // Only take blocks, and data, that would go back to our own pool anyway:
+   if ((G.BlockOwner != NULL && G.BlockOwner != Pool) ||
+       (G.Storage != NULL && DataInfo (G.Storage->Data)->Owner != NULL && DataInfo (G.Storage->Data)->Owner != Pool))
+      return (*this) = (const Genome &) G;
+
+   Contiguous = G.Contiguous;
+
+   Release ();
+
+   Swap (G);
+
+   return *this;
+}
+
+Genome Genome::operator + (const Genome &G) const {
+   return Cross (G, GetGenerator ());
+}
+
+Genome Genome::Cross (const Genome &G, Generator &Rng) const {
+   Genome Temp;
+
+   Cross (G, Temp, Rng);
+
+   return Temp;
+}
+
+bool Genome::Cross (const Genome &G, Genome &Child, Generator &Rng) const {
+   if (ChromosomeCount != G.ChromosomeCount) {
+      throw;
+   }
+
+   // Reshaping a parent would destroy it, breed into a scratch genome:
+   if (&Child == this || &Child == &G) {
+      Genome Temp;
+
+      Temp.Pool = Child.Pool;
+
+      Cross (G, Temp, Rng);
+
+      Child = std::move (Temp);
+
+      return true;
+   }
+
+   Child.Contiguous = Contiguous;
+
+   // Offspring of two packed parents is built straight into its own block,
+   // which is reused when the child already has the right shape:
+   if (Storage != NULL && G.Storage != NULL && DataGenes == G.DataGenes && DataLength == G.DataLength) {
+      if (Child.Storage == NULL || Child.ChromosomeCount != ChromosomeCount || Child.DataGenes != DataGenes || Child.DataLength != DataLength) {
+         Child.Release ();
+
+         Child.Build (ChromosomeCount, DataGenes, DataLength);
+      }
+
+      // Every gene is written, data still shared needn't be copied first:
+      Child.Storage->Own (false);
+   }
+   else if (Child.Storage != NULL || Child.ChromosomeCount != ChromosomeCount)
+      Child.SetChromosomeCount (ChromosomeCount);
+
+   for (int i = 0; i < ChromosomeCount; i++)
+      ChromosomeList [i].Cross (G.ChromosomeList [i], Child.ChromosomeList [i], Rng);
+
+   Child.Hashed = false;
+
+   return true;
+}
+
+bool Genome::Mutate () {
+   return Mutate (GetGenerator ());
+}
+
+bool Genome::Mutate (Generator &Rng) {
+   // One cursor spans the whole genome:
+   MutationCursor Cursor;
+
+   if (!Hashed) {
+      for (int i = 0; i < ChromosomeCount; i++) {
+         ChromosomeList [i].MutateChromosome (Rng);
+         ChromosomeList [i].MutateGenes (Rng, Cursor);
+      }
+
+      return true;
+   }
+
+   // Same walk as Chromosome::MutateGenes and Gene::Mutate, swapping each
+   // changed value's hash term as it goes:
+   for (int i = 0; i < ChromosomeCount; i++) {
+      Chromosome &Chrom = ChromosomeList [i];
+
+      bool Cross = Chrom.Crossover;
+
+      Chrom.MutateChromosome (Rng);
+
+      if (Chrom.Crossover != Cross) {
+         unsigned long long Base = HashBase (i, -1);
+
+         Hash += HashTerm (Base, 0, (unsigned long long) Chrom.Crossover) - HashTerm (Base, 0, (unsigned long long) Cross);
+      }
+
+      for (int j = 0; j < Chrom.GeneCount; j++) {
+         Gene &G = Chrom.GeneList [j];
+
+         if (G.SequenceLength <= 0)
+            continue;
+
+         if (Cursor.Chance != G.MutationChance)
+            Cursor.Reset (G.MutationChance, Rng);
+
+         long long k = Cursor.Gap;
+
+         if (k < G.SequenceLength) {
+            unsigned long long Base = HashBase (i, j, G.SequenceLength);
+
+            G.Own ();
+
+            while (k < G.SequenceLength) {
+               int p = (int) (k >> 1);
+
+               unsigned long long Old = HashPair (Base, G.Sequence, G.SequenceLength, p);
+
+               G.Sequence [k] = G.Sequence [k] + (2.0F * Rng.Random () - 1.0F) * G.MutationRate;
+
+               Hash += HashPair (Base, G.Sequence, G.SequenceLength, p) - Old;
 
-bool Genome::SetChromosome (int i, const Chromosome &Chrom) {
-   if (i < 0 || i >= ChromosomeCount)
-      return false;
+               k += 1 + Cursor.Draw (Rng);
+            }
+         }
 
-   ChromosomeList [i] = Chrom;
+         Cursor.Gap = k - G.SequenceLength;
+      }
+   }
 
    return true;
 }
 
-Chromosome &Genome::GetChromosome (int i) const {
-   if (i < 0 || i >= ChromosomeCount) {
-      throw;
+bool Genome::MutateMutationFactors (float Chance, float Rate) {
+   return MutateMutationFactors (Chance, Rate, GetGenerator ());
+}
+
+bool Genome::MutateMutationFactors (float Chance, float Rate, Generator &Rng) {
+   if (!Hashed) {
+      for (int i = 0; i < ChromosomeCount; i++) {
+         ChromosomeList [i].MutateMutationFactors (Chance, Rate, Rng);
+      }
+
+      return true;
    }
 
-   return *(&ChromosomeList [i]);
-}
+   // As Chromosome::MutateMutationFactors, keeping the hash in step:
+   for (int i = 0; i < ChromosomeCount; i++) {
+      Chromosome &Chrom = ChromosomeList [i];
 
-bool Genome::SetChromosomeCount (int Count) {
-   if (Count < 0)
-      return false;
+      if (Rng.Random () <= Chance) {
+         unsigned long long Base = HashBase (i, -1);
 
-   delete [] ChromosomeList;
+         float Old = Chrom.CrossoverMutationChance;
 
-   ChromosomeCount = Count;
+         Chrom.SetCrossoverMutationChance (Old + (Rng.Random () * 2.0F - 1.0F) * Rate);
 
-   ChromosomeList = new Chromosome [ChromosomeCount];
+         Hash += HashTerm (Base, 1, Chrom.CrossoverMutationChance) - HashTerm (Base, 1, Old);
+      }
 
-   return true;   
-}
+      for (int j = 0; j < Chrom.GeneCount; j++) {
+         Gene &G = Chrom.GeneList [j];
 
-int Genome::GetChromosomeCount () const {
-   return ChromosomeCount;
-}
+         float OldChance = G.MutationChance, OldRate = G.MutationRate;
 
-Genome &Genome::operator = (const Genome &G) {
-   ChromosomeCount = G.ChromosomeCount;
+         G.MutateMutationFactors (Chance, Rate, Rng);
 
-   SetChromosomeCount (ChromosomeCount);
+         if (G.MutationChance != OldChance || G.MutationRate != OldRate) {
+            unsigned long long Base = HashBase (i, j, G.SequenceLength);
 
-   for (int i = 0; i < ChromosomeCount; i++)
-      ChromosomeList [i] = G.ChromosomeList [i];
+            Hash += HashFactors (Base, G.MutationChance, G.MutationRate) - HashFactors (Base, OldChance, OldRate);
+         }
+      }
+   }
 
-   return *this;
+   return true;
 }
 
-Genome Genome::operator + (const Genome &G) const {
-   Genome Temp;
+unsigned long long Genome::ComputeHash () const {
+   unsigned long long Sum = HashMix ((unsigned long long) ChromosomeCount + 0x9E3779B97F4A7C15ULL);
 
-   if (ChromosomeCount != G.ChromosomeCount) {
-      throw;
-   }
+   for (int i = 0; i < ChromosomeCount; i++) {
+      const Chromosome &Chrom = ChromosomeList [i];
 
-   Temp.SetChromosomeCount (ChromosomeCount);
+      unsigned long long Base = HashBase (i, -1);
 
-   for (int i = 0; i < ChromosomeCount; i++)
-      Temp.ChromosomeList [i] = ChromosomeList [i] + G.ChromosomeList [i];
+      Sum += HashTerm (Base, 0, (unsigned long long) Chrom.Crossover);
+      Sum += HashTerm (Base, 1, Chrom.CrossoverMutationChance);
 
-   return Temp;
+      for (int j = 0; j < Chrom.GeneCount; j++) {
+         const Gene &G = Chrom.GeneList [j];
+
+         Base = HashBase (i, j, G.SequenceLength);
+
+         Sum += HashFactors (Base, G.MutationChance, G.MutationRate);
+
+         for (int p = 0; 2 * p < G.SequenceLength; p++)
+            Sum += HashPair (Base, G.Sequence, G.SequenceLength, p);
+      }
+   }
+
+   return Sum;
 }
 
-bool Genome::Mutate () {
-   for (int i = 0; i < ChromosomeCount; i++) {
-      ChromosomeList [i].Mutate ();
+unsigned long long Genome::GetHash () const {
+   if (!Hashed) {
+      Hash   = ComputeHash ();
+      Hashed = true;
    }
 
+   return Hash;
+}
+
+bool Genome::InvalidateHash () {
+   Hashed = false;
+
    return true;
 }
 
-bool Genome::MutateMutationFactors (float Chance, float Rate) {
+bool Genome::operator == (const Genome &G) const {
+   if (this == &G)
+      return true;
+
+   if (ChromosomeCount != G.ChromosomeCount)
+      return false;
+
+   // Different hashes can't be equal genomes:
+   if (Hashed && G.Hashed && Hash != G.Hash)
+      return false;
+
    for (int i = 0; i < ChromosomeCount; i++) {
-      ChromosomeList [i].MutateMutationFactors (Chance, Rate);
+      const Chromosome &A = ChromosomeList [i], &B = G.ChromosomeList [i];
+
+      if (A.Crossover != B.Crossover || A.GeneCount != B.GeneCount ||
+          memcmp (&A.CrossoverMutationChance, &B.CrossoverMutationChance, sizeof (float)) != 0)
+         return false;
+
+      for (int j = 0; j < A.GeneCount; j++) {
+         const Gene &X = A.GeneList [j], &Y = B.GeneList [j];
+
+         if (X.SequenceLength != Y.SequenceLength ||
+             memcmp (&X.MutationChance, &Y.MutationChance, sizeof (float)) != 0 ||
+             memcmp (&X.MutationRate, &Y.MutationRate, sizeof (float)) != 0)
+            return false;
+
+         if (X.SequenceLength > 0 && X.Sequence != Y.Sequence && memcmp (X.Sequence, Y.Sequence, sizeof (float) * X.SequenceLength) != 0)
+            return false;
+      }
    }
 
    return true;
@@ -509,9 +1772,12 @@ bool Genome::Load (std::fstream &File) {
    //          ChromosomeCount       sizeof (int)
    //          ChromosomeList        varies
 
-   File.read ((char *) &ChromosomeCount, sizeof (int));
+   int Count = 0;
 
-   SetChromosomeCount (ChromosomeCount);
+   File.read ((char *) &Count, sizeof (int));
+
+   if (!File.good () || !SetChromosomeCount (Count))
+      return false;
 
    for (int i = 0; i < ChromosomeCount; i++)
       ChromosomeList [i].Load (File);
@@ -519,6 +1785,517 @@ bool Genome::Load (std::fstream &File) {
    if (!File.good ())
       return false;
 
+   // Contiguous genomes go back into a single block:
+   if (Contiguous)
+      Pack ();
+
    return true;   
 }
 
+
+size_t Genome::GetBufferSize () const {
+   size_t Size = ADAPTAI_BULK_HEADER + 3 * sizeof (int) * ChromosomeCount;
+
+   for (int i = 0; i < ChromosomeCount; i++) {
+      const Chromosome &Chrom = ChromosomeList [i];
+
+      Size += 3 * sizeof (int) * Chrom.GeneCount;
+
+      for (int j = 0; j < Chrom.GeneCount; j++)
+         Size += sizeof (float) * Chrom.GeneList [j].SequenceLength;
+   }
+
+   return Size;
+}
+
+size_t Genome::SaveBuffer (char *Buffer, size_t Size) const {
+   // Buffer Format:
+   //          Magic                 4 chars
+   //          Version               sizeof (int)
+   //          ChromosomeCount       sizeof (int)
+   //          GeneTotal             sizeof (int)
+   //          Size                  sizeof (long long)
+   //          Chromosomes           (GeneCount, Crossover, CrossoverMutationChance) x ChromosomeCount
+   //          Genes                 (Length, MutationChance, MutationRate) x GeneTotal
+   //          Data                  sizeof (float) x every gene's Length
+   size_t Total = GetBufferSize ();
+
+   if (Buffer == NULL || Size < Total)
+      return 0;
+
+   int i, j, GeneTotal = 0;
+
+   for (i = 0; i < ChromosomeCount; i++)
+      GeneTotal += ChromosomeList [i].GeneCount;
+
+   int       Version = ADAPTAI_BULK_VERSION;
+   long long Bytes   = Total;
+
+   memcpy (Buffer,      ADAPTAI_BULK_MAGIC, 4);
+   memcpy (Buffer + 4,  &Version,           sizeof (int));
+   memcpy (Buffer + 8,  &ChromosomeCount,   sizeof (int));
+   memcpy (Buffer + 12, &GeneTotal,         sizeof (int));
+   memcpy (Buffer + 16, &Bytes,             sizeof (long long));
+
+   char *Chroms = Buffer + ADAPTAI_BULK_HEADER;
+   char *Genes  = Chroms + 3 * sizeof (int) * ChromosomeCount;
+   char *Out    = Genes  + 3 * sizeof (int) * GeneTotal;
+
+   for (i = 0; i < ChromosomeCount; i++) {
+      const Chromosome &Chrom = ChromosomeList [i];
+
+      int Crossover = Chrom.Crossover ? 1 : 0;
+
+      memcpy (Chroms,     &Chrom.GeneCount,               sizeof (int));
+      memcpy (Chroms + 4, &Crossover,                     sizeof (int));
+      memcpy (Chroms + 8, &Chrom.CrossoverMutationChance, sizeof (float));
+
+      Chroms += 3 * sizeof (int);
+
+      for (j = 0; j < Chrom.GeneCount; j++) {
+         const Gene &G = Chrom.GeneList [j];
+
+         memcpy (Genes,     &G.SequenceLength, sizeof (int));
+         memcpy (Genes + 4, &G.MutationChance, sizeof (float));
+         memcpy (Genes + 8, &G.MutationRate,   sizeof (float));
+
+         Genes += 3 * sizeof (int);
+
+         // Packed genomes go out in one copy below:
+         if (Storage != NULL)
+            continue;
+
+         if (G.SequenceLength > 0)
+            memcpy (Out, G.Sequence, sizeof (float) * G.SequenceLength);
+
+         Out += sizeof (float) * G.SequenceLength;
+      }
+   }
+
+   if (Storage != NULL)
+      memcpy (Out, Storage->Data, sizeof (float) * Storage->Floats);
+
+   return Total;
+}
+
+size_t Genome::LoadBuffer (const char *Buffer, size_t Size) {
+   if (Buffer == NULL || Size < ADAPTAI_BULK_HEADER || memcmp (Buffer, ADAPTAI_BULK_MAGIC, 4) != 0)
+      return 0;
+
+   int       Version, Count, GeneTotal;
+   long long Bytes;
+
+   memcpy (&Version,   Buffer + 4,  sizeof (int));
+   memcpy (&Count,     Buffer + 8,  sizeof (int));
+   memcpy (&GeneTotal, Buffer + 12, sizeof (int));
+   memcpy (&Bytes,     Buffer + 16, sizeof (long long));
+
+   if (Version != ADAPTAI_BULK_VERSION || Count < 0 || GeneTotal < 0 || Bytes < 0 || (size_t) Bytes > Size)
+      return 0;
+
+   if (ADAPTAI_BULK_HEADER + 3 * sizeof (int) * ((long long) Count + GeneTotal) > (size_t) Bytes)
+      return 0;
+
+   const char *Chroms = Buffer + ADAPTAI_BULK_HEADER;
+   const char *Genes  = Chroms + 3 * sizeof (int) * Count;
+   const char *In     = Genes  + 3 * sizeof (int) * GeneTotal;
+
+   // Check the tables against the stated size before touching the genome:
+   int i, j, Value, Genes0 = -1, Length0 = -1, Seen = 0;
+
+   bool Uniform = true;
+
+   long long Floats = 0;
+
+   for (i = 0; i < Count; i++) {
+      memcpy (&Value, Chroms + 3 * sizeof (int) * i, sizeof (int));
+
+      if (Value < 0 || Value > GeneTotal - Seen)
+         return 0;
+
+      if (Genes0 < 0)
+         Genes0 = Value;
+      else if (Value != Genes0)
+         Uniform = false;
+
+      Seen += Value;
+   }
+
+   if (Seen != GeneTotal)
+      return 0;
+
+   for (i = 0; i < GeneTotal; i++) {
+      memcpy (&Value, Genes + 3 * sizeof (int) * i, sizeof (int));
+
+      if (Value < 0)
+         return 0;
+
+      if (Length0 < 0)
+         Length0 = Value;
+      else if (Value != Length0)
+         Uniform = false;
+
+      Floats += Value;
+   }
+
+   if (Floats > (Bytes - (In - Buffer)) / (long long) sizeof (float))
+      return 0;
+
+   // Uniform shapes load straight into the block, reused when it already fits:
+   bool Packed = Contiguous && Uniform && Genes0 > 0 && Length0 > 0;
+
+   if (Packed)
+      SetShape (Count, Genes0, Length0);
+   else if (Storage != NULL || ChromosomeCount != Count)
+      SetChromosomeCount (Count);
+
+   for (i = 0; i < Count; i++) {
+      Chromosome &Chrom = ChromosomeList [i];
+
+      int   GeneCount, Crossover;
+      float Chance;
+
+      memcpy (&GeneCount, Chroms,     sizeof (int));
+      memcpy (&Crossover, Chroms + 4, sizeof (int));
+      memcpy (&Chance,    Chroms + 8, sizeof (float));
+
+      Chroms += 3 * sizeof (int);
+
+      if (Chrom.GeneCount != GeneCount)
+         Chrom.SetGeneCount (GeneCount);
+
+      // Raw like Load, factors aren't re-clamped:
+      Chrom.Crossover               = (Crossover != 0);
+      Chrom.CrossoverMutationChance = Chance;
+
+      for (j = 0; j < GeneCount; j++) {
+         Gene &G = Chrom.GeneList [j];
+
+         int   Length;
+         float Rate;
+
+         memcpy (&Length, Genes,     sizeof (int));
+         memcpy (&Chance, Genes + 4, sizeof (float));
+         memcpy (&Rate,   Genes + 8, sizeof (float));
+
+         Genes += 3 * sizeof (int);
+
+         G.MutationChance = Chance;
+         G.MutationRate   = Rate;
+
+         if (Packed)
+            continue;
+
+         if (G.SequenceLength != Length)
+            G.SetLength (Length);
+         else G.Own ();
+
+         if (Length > 0)
+            memcpy (G.Sequence, In, sizeof (float) * Length);
+
+         In += sizeof (float) * Length;
+      }
+   }
+
+   if (Packed)
+      memcpy (Storage->Data, In, sizeof (float) * Floats);
+   else if (Contiguous)
+      Pack ();
+
+   Hashed = false;
+
+   return (size_t) Bytes;
+}
+
+bool Genome::SameShape (const Genome &G) const {
+   if (ChromosomeCount != G.ChromosomeCount)
+      return false;
+
+   for (int i = 0; i < ChromosomeCount; i++) {
+      if (ChromosomeList [i].GeneCount != G.ChromosomeList [i].GeneCount)
+         return false;
+   }
+
+   return true;
+}
+
+bool Genome::SaveDelta (const Genome *Base, const Genome *Mate, std::vector<char> &Out) const {
+   // Delta Format:
+   //          ChromosomeCount       sizeof (int)
+   //          Chromosomes           (Crossover, CrossoverMutationChance) x ChromosomeCount
+   //          Genes                 Tag (1 byte) and what it needs, per gene:
+   //                                  BASE, MATE         nothing, the gene is unchanged
+   //                                  PATCH, PATCH_MATE  MutationChance, MutationRate, Count,
+   //                                                     (Index, Value) x Count
+   //                                  LITERAL            Length, MutationChance, MutationRate,
+   //                                                     sizeof (float) x Length
+   if (Base == NULL || !SameShape (*Base))
+      return false;
+
+   if (Mate != NULL && !SameShape (*Mate))
+      Mate = NULL;
+
+   // Bit for bit, shared data needs no look:
+   auto Same = [] (const Gene &A, const Gene &B) {
+      if (A.SequenceLength != B.SequenceLength ||
+          memcmp (&A.MutationChance, &B.MutationChance, sizeof (float)) != 0 ||
+          memcmp (&A.MutationRate, &B.MutationRate, sizeof (float)) != 0)
+         return false;
+
+      return A.Sequence == B.Sequence || A.SequenceLength == 0 ||
+             memcmp (A.Sequence, B.Sequence, sizeof (float) * A.SequenceLength) == 0;
+   };
+
+   // Elements that differ, -1 when the lengths do:
+   auto Changed = [] (const Gene &A, const Gene &B) {
+      if (A.SequenceLength != B.SequenceLength)
+         return -1;
+
+      int Count = 0;
+
+      for (int k = 0; k < A.SequenceLength; k++)
+         Count += memcmp (&A.Sequence [k], &B.Sequence [k], sizeof (float)) != 0;
+
+      return Count;
+   };
+
+   int i, j, k;
+
+   Append (Out, &ChromosomeCount, sizeof (int));
+
+   for (i = 0; i < ChromosomeCount; i++) {
+      char Cross = ChromosomeList [i].Crossover ? 1 : 0;
+
+      Append (Out, &Cross, 1);
+      Append (Out, &ChromosomeList [i].CrossoverMutationChance, sizeof (float));
+   }
+
+   for (i = 0; i < ChromosomeCount; i++) {
+      for (j = 0; j < ChromosomeList [i].GeneCount; j++) {
+         const Gene &G = ChromosomeList [i].GeneList [j];
+         const Gene &B = Base->ChromosomeList [i].GeneList [j];
+         const Gene *M = (Mate != NULL) ? &Mate->ChromosomeList [i].GeneList [j] : NULL;
+
+         char Tag = ADAPTAI_DELTA_LITERAL;
+
+         if (Same (G, B))
+            Tag = ADAPTAI_DELTA_BASE;
+         else if (M != NULL && Same (G, *M))
+            Tag = ADAPTAI_DELTA_MATE;
+
+         if (Tag != ADAPTAI_DELTA_LITERAL) {
+            Append (Out, &Tag, 1);
+
+            continue;
+         }
+
+         // Patch whichever parent is closer, while that beats a full copy:
+         int FromBase = Changed (G, B), FromMate = (M != NULL) ? Changed (G, *M) : -1;
+
+         const Gene *Source = NULL;
+         int        Count   = 0;
+
+         if (FromBase >= 0 && (FromMate < 0 || FromBase <= FromMate)) {
+            Tag    = ADAPTAI_DELTA_PATCH;
+            Source = &B;
+            Count  = FromBase;
+         }
+         else if (FromMate >= 0) {
+            Tag    = ADAPTAI_DELTA_PATCH_MATE;
+            Source = M;
+            Count  = FromMate;
+         }
+
+         if (Source != NULL && 2 * Count < G.SequenceLength) {
+            Append (Out, &Tag, 1);
+            Append (Out, &G.MutationChance, sizeof (float));
+            Append (Out, &G.MutationRate,   sizeof (float));
+            Append (Out, &Count,            sizeof (int));
+
+            for (k = 0; k < G.SequenceLength; k++) {
+               if (memcmp (&G.Sequence [k], &Source->Sequence [k], sizeof (float)) == 0)
+                  continue;
+
+               Append (Out, &k,               sizeof (int));
+               Append (Out, &G.Sequence [k], sizeof (float));
+            }
+
+            continue;
+         }
+
+         Tag = ADAPTAI_DELTA_LITERAL;
+
+         Append (Out, &Tag, 1);
+         Append (Out, &G.SequenceLength, sizeof (int));
+         Append (Out, &G.MutationChance, sizeof (float));
+         Append (Out, &G.MutationRate,   sizeof (float));
+
+         if (G.SequenceLength > 0)
+            Append (Out, G.Sequence, sizeof (float) * G.SequenceLength);
+      }
+   }
+
+   return true;
+}
+
+size_t Genome::LoadDelta (const Genome *Base, const Genome *Mate, const char *Buffer, size_t Size) {
+   if (Buffer == NULL || Base == NULL || Base == this || Mate == this)
+      return 0;
+
+   if (Mate != NULL && !Base->SameShape (*Mate))
+      Mate = NULL;
+
+   const char *In = Buffer, *End = Buffer + Size;
+
+   auto Read = [&] (void *To, size_t Bytes) {
+      if ((size_t) (End - In) < Bytes)
+         return false;
+
+      memcpy (To, In, Bytes);
+
+      In += Bytes;
+
+      return true;
+   };
+
+   int i, j, Count;
+
+   if (!Read (&Count, sizeof (int)) || Count != Base->ChromosomeCount)
+      return 0;
+
+   // Start from Base, unchanged genes are then already in place:
+   (*this) = *Base;
+
+   for (i = 0; i < ChromosomeCount; i++) {
+      char Cross;
+
+      if (!Read (&Cross, 1) || !Read (&ChromosomeList [i].CrossoverMutationChance, sizeof (float)))
+         return 0;
+
+      ChromosomeList [i].Crossover = (Cross != 0);
+   }
+
+   Hashed = false;
+
+   for (i = 0; i < ChromosomeCount; i++) {
+      for (j = 0; j < ChromosomeList [i].GeneCount; j++) {
+         Gene &G = ChromosomeList [i].GeneList [j];
+
+         char Tag;
+
+         if (!Read (&Tag, 1))
+            return 0;
+
+         if (Tag == ADAPTAI_DELTA_BASE)
+            continue;
+
+         if (Tag == ADAPTAI_DELTA_MATE || Tag == ADAPTAI_DELTA_PATCH_MATE) {
+            if (Mate == NULL)
+               return 0;
+
+            G = Mate->ChromosomeList [i].GeneList [j];
+
+            if (Tag == ADAPTAI_DELTA_MATE)
+               continue;
+         }
+
+         if (Tag == ADAPTAI_DELTA_PATCH || Tag == ADAPTAI_DELTA_PATCH_MATE) {
+            int Index, Changes;
+
+            if (!Read (&G.MutationChance, sizeof (float)) || !Read (&G.MutationRate, sizeof (float)) ||
+                !Read (&Changes, sizeof (int)) || Changes < 0 || Changes > G.SequenceLength)
+               return 0;
+
+            G.Own ();
+
+            for (int k = 0; k < Changes; k++) {
+               if (!Read (&Index, sizeof (int)) || Index < 0 || Index >= G.SequenceLength ||
+                   !Read (&G.Sequence [Index], sizeof (float)))
+                  return 0;
+            }
+
+            continue;
+         }
+
+         if (Tag != ADAPTAI_DELTA_LITERAL)
+            return 0;
+
+         int Length;
+
+         if (!Read (&Length, sizeof (int)) || Length < 0 ||
+             !Read (&G.MutationChance, sizeof (float)) || !Read (&G.MutationRate, sizeof (float)))
+            return 0;
+
+         // A view can't change length:
+         if (Length != G.SequenceLength) {
+            if (G.View || !G.SetLength (Length))
+               return 0;
+         }
+         else G.Own ();
+
+         if (Length > 0 && !Read (G.Sequence, sizeof (float) * Length))
+            return 0;
+      }
+   }
+
+   return In - Buffer;
+}
+
+bool Genome::SaveBulk (std::fstream &File) const {
+   size_t Size = GetBufferSize ();
+
+   char *Buffer = new char [Size];
+
+   SaveBuffer (Buffer, Size);
+
+   File.write (Buffer, Size);
+
+   delete [] Buffer;
+
+   if (!File.good ())
+      return false;
+
+   return true;
+}
+
+bool Genome::LoadBulk (std::fstream &File) {
+   // The fixed header says how much follows, the rest comes in one read:
+   char Header [ADAPTAI_BULK_HEADER];
+
+   File.read (Header, ADAPTAI_BULK_HEADER);
+
+   int       Version;
+   long long Bytes;
+
+   memcpy (&Version, Header + 4,  sizeof (int));
+   memcpy (&Bytes,   Header + 16, sizeof (long long));
+
+   if (!File.good () || memcmp (Header, ADAPTAI_BULK_MAGIC, 4) != 0 ||
+       Version != ADAPTAI_BULK_VERSION || Bytes < ADAPTAI_BULK_HEADER)
+      return false;
+
+   // A bad size must not get as far as the allocation, so it can't claim
+   // more than the stream still holds:
+   std::streampos Start = File.tellg ();
+
+   File.seekg (0, std::ios::end);
+
+   std::streampos End = File.tellg ();
+
+   File.seekg (Start);
+
+   if (!File.good () || Start < 0 || Bytes - ADAPTAI_BULK_HEADER > (long long) (End - Start))
+      return false;
+
+   char *Buffer = new char [Bytes];
+
+   memcpy (Buffer, Header, ADAPTAI_BULK_HEADER);
+
+   File.read (Buffer + ADAPTAI_BULK_HEADER, Bytes - ADAPTAI_BULK_HEADER);
+
+   bool Result = File.good () && LoadBuffer (Buffer, Bytes) != 0;
+
+   delete [] Buffer;
+
+   return Result;
+}
@@ -15,24 +15,126 @@
 #define ADAPTAI_DEFAULTCHANCE 0.001F
 #define ADAPTAI_DEFAULTRATE   0.1F
 
+// Byte alignment of contiguous genome storage:
+#define ADAPTAI_ALIGNMENT     64
+
+// Genome bulk buffer format:
+#define ADAPTAI_BULK_MAGIC    "AGEN"
+#define ADAPTAI_BULK_VERSION  1
+#define ADAPTAI_BULK_HEADER   24
+
 #include <fstream>
 #include <string>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <math.h>
 #include <stdlib.h>
 
+#include "AdaptRand.h"
+
 namespace AdaptAI {
 
+   class Chromosome;
+   class Gene;
+   class Genome;
+
+   // Recycles aligned blocks by exact size. A population's genomes all have
+   // the same size, so once the first generation is freed every new genome
+   // is one list pop. Safe to share between threads; must outlive every
+   // genome allocated from it, and every genome sharing data that was.
+   class GenomePool {
+      protected:
+         std::mutex Lock;
+
+         std::unordered_map<size_t, std::vector<float *> > Blocks;
+
+         size_t Cached;
+
+      public:
+         GenomePool  ();
+         ~GenomePool ();
+
+         float *Allocate (size_t Count);
+         bool   Release  (float *Block, size_t Count);
+
+         bool   Trim      ();
+         size_t GetCached () const;
+   };
+
+   // Distance to the next element to mutate, drawn from a geometric
+   // distribution. Carried from gene to gene, so mutation costs one draw per
+   // mutated element instead of one per element:
+   class MutationCursor {
+      public:
+         float     Chance;
+         double    LogMiss;
+         long long Gap;
+
+         MutationCursor ();
+
+         bool      Reset (float C, Generator &Rng);
+         long long Draw  (Generator &Rng) const;
+   };
+
+   // Front of a contiguous genome's block. The coefficients it points to
+   // are reference counted, so copies of the genome can share them; the
+   // first write through any of its genes copies them for that genome:
+   class GenomeData {
+      friend class Gene;
+      friend class Genome;
+
+      protected:
+         float *Data;
+         size_t Floats;
+
+         Gene *GeneList;
+         int  GeneCount;
+
+         // Where copies of the data come from:
+         GenomePool *Pool;
+
+         // Points the genes at To and lets go of the current data:
+         bool Rebind (float *To);
+
+         // Makes Data this genome's alone, keeping its contents if Keep:
+         bool Own   (bool Keep = true);
+         bool Share (float *Shared);
+   };
+
    class Gene {
+      friend class Chromosome;
+      friend class Genome;
+      friend class GenomeData;
+
       protected:
          float *Sequence, MutationChance, MutationRate;
 
          int SequenceLength;
 
+         // True when Sequence points into storage owned by someone else.
+         // Otherwise Sequence is reference counted: copies share it and the
+         // first write through any of them copies it first:
+         bool View;
+
+         // The genome data a view's buffer belongs to, NULL when owned:
+         GenomeData *Storage;
+
+         bool Bind   (float *Buffer, int Length);
+         bool Detach ();
+
+         // Makes Sequence this gene's alone, call before writing to it:
+         bool Own ();
+
       public:
          Gene  ();      
          Gene  (const Gene &Gene);
+         Gene  (Gene &&G);
          ~Gene ();
 
+         bool IsView   () const;
+         bool IsShared () const;
+
          bool  SetElement (int i, float El);
          float GetElement (int i) const;
 
@@ -46,17 +148,26 @@ namespace AdaptAI {
          float GetMutationRate () const;
 
          bool Mutate ();
+         bool Mutate (Generator &Rng);
+         bool Mutate (Generator &Rng, MutationCursor &Cursor);
 
          bool MutateMutationFactors (float Chance, float Rate);
+         bool MutateMutationFactors (float Chance, float Rate, Generator &Rng);
 
          Gene &operator = (const Gene &G);
+         Gene &operator = (Gene &&G);
          Gene operator  + (const Gene &G) const;
 
+         // In-place operator +, A and B may be this gene:
+         bool Average (const Gene &A, const Gene &B);
+
          bool Save (std::fstream &File) const;
          bool Load (std::fstream &File);
    };
 
    class Chromosome {
+      friend class Genome;
+
       protected:
          Gene *GeneList;
 
@@ -65,11 +176,21 @@ namespace AdaptAI {
          bool  Crossover;
          float CrossoverMutationChance;
 
+         // True when the genes, and the data they view, belong to a genome's
+         // contiguous block:
+         bool Bound;
+
+         bool Bind   (Gene *Genes, float *Buffer, int Count, int Length);
+         bool Detach ();
+
       public:
          Chromosome  ();
          Chromosome  (const Chromosome &Chrom);
+         Chromosome  (Chromosome &&Chrom);
          ~Chromosome ();
 
+         bool IsBound () const;
+
          bool SetGene  (int i, const Gene &G);
          Gene &GetGene (int i) const;
 
@@ -77,8 +198,12 @@ namespace AdaptAI {
          int  GetGeneCount () const;
 
          Chromosome &operator = (const Chromosome &Chrom);
+         Chromosome &operator = (Chromosome &&Chrom);
          Chromosome operator  + (const Chromosome &Chrom) const;
 
+         Chromosome Cross (const Chromosome &Chrom, Generator &Rng) const;
+         bool       Cross (const Chromosome &Chrom, Chromosome &Child, Generator &Rng) const;
+
          bool SetCrossoverState (bool State);
          bool GetCrossoverState ();
 
@@ -86,10 +211,15 @@ namespace AdaptAI {
          float GetCrossoverMutationChance ();
 
          bool MutateChromosome ();
+         bool MutateChromosome (Generator &Rng);
          bool MutateGenes      ();
+         bool MutateGenes      (Generator &Rng);
+         bool MutateGenes      (Generator &Rng, MutationCursor &Cursor);
          bool Mutate ();
+         bool Mutate (Generator &Rng);
 
          bool MutateMutationFactors (float Chance, float Rate);
+         bool MutateMutationFactors (float Chance, float Rate, Generator &Rng);
 
          bool Save (std::fstream &File) const;
          bool Load (std::fstream &File);
@@ -101,11 +231,54 @@ namespace AdaptAI {
 
          int ChromosomeCount;
 
+         // Contiguous storage mode. One aligned block holds the chromosomes
+         // and their genes, which view the ChromosomeCount x DataGenes x
+         // DataLength data. Copies from the same pool share the data:
+         bool       Contiguous;
+         GenomeData *Storage;
+         int        DataGenes, DataLength;
+
+         float  *Block;
+         size_t BlockSize;
+
+         // Where new blocks come from and where the current one goes back to,
+         // NULL for the heap:
+         GenomePool *Pool, *BlockOwner;
+
+         // Content hash, computed on first request and then kept up to date
+         // by Mutate and MutateMutationFactors:
+         mutable unsigned long long Hash;
+         mutable bool               Hashed;
+
+         unsigned long long ComputeHash () const;
+
+         bool Build   (int Count, int Genes, int Length);
+         bool Release ();
+         void Swap    (Genome &G);
+
+         // Same chromosome count and gene count in every chromosome:
+         bool SameShape (const Genome &G) const;
+
+         bool Pack   ();
+         bool Unpack ();
+
       public:
          Genome  ();
          Genome (const Genome &G);
+         Genome (Genome &&G) noexcept;
          ~Genome ();
 
+         bool SetShape (int Count, int Genes, int Length);
+
+         bool SetContiguous (bool State);
+         bool GetContiguous () const;
+
+         float       *GetData ();
+         const float *GetData () const;
+
+         bool       SetPool (GenomePool *P);
+         GenomePool *GetPool () const;
+
          bool       SetChromosome  (int i, const Chromosome &Chrom);
          Chromosome &GetChromosome (int i) const;
 
@@ -113,17 +286,55 @@ namespace AdaptAI {
          int  GetChromosomeCount () const;
 
          Genome &operator = (const Genome &G);
+         Genome &operator = (Genome &&G);
          Genome operator  + (const Genome &G) const;
 
+         Genome Cross (const Genome &G, Generator &Rng) const;
+         bool   Cross (const Genome &G, Genome &Child, Generator &Rng) const;
+
          bool Mutate ();
+         bool Mutate (Generator &Rng);
 
          bool MutateMutationFactors (float Chance, float Rate);
+         bool MutateMutationFactors (float Chance, float Rate, Generator &Rng);
+
+         // 64-bit hash of the shape, traits, mutation factors and coefficients,
+         // equal for genomes that compare equal. Writes made through
+         // GetChromosome must be followed by InvalidateHash. Not safe to call
+         // on one genome from several threads at once:
+         unsigned long long GetHash () const;
+         bool               InvalidateHash ();
+
+         // Same content bit for bit, whatever the storage mode:
+         bool operator == (const Genome &G) const;
 
          bool Save (std::fstream &File) const;
          bool Load (std::fstream &File);        
+
+         // Whole genome in one buffer. Save/LoadBuffer return the bytes used,
+         // 0 when the buffer is too small or not a genome:
+         size_t GetBufferSize () const;
+         size_t SaveBuffer    (char *Buffer, size_t Size) const;
+         size_t LoadBuffer    (const char *Buffer, size_t Size);
+
+         bool SaveBulk (std::fstream &File) const;
+         bool LoadBulk (std::fstream &File);
+
+         // Differences from Base, or from Mate for genes that match it
+         // better, down to single elements. SaveDelta appends them to Out and
+         // fails unless Base is shaped like this genome; a Mate that isn't is
+         // ignored. LoadDelta rebuilds the genome from the same Base and Mate
+         // and returns the bytes used, 0 on a bad buffer. Neither Base nor
+         // Mate may be this genome:
+         bool   SaveDelta (const Genome *Base, const Genome *Mate, std::vector<char> &Out) const;
+         size_t LoadDelta (const Genome *Base, const Genome *Mate, const char *Buffer, size_t Size);
    };
 
+   // Uniform number in [0, 1) from the calling thread's generator:
    extern float Random ();
+
+   extern float *AllocateAligned (size_t Count);
+   extern void  FreeAligned     (float *Block);
 }
 
 #endif
@@ -0,0 +1,707 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptBatch.cpp
+  Purpose:      Implementation for the AdaptOrg organism batch.
+*****************************************************************************/
+
+#include <string.h>
+
+#include "AdaptBatch.h"
+#include "AdaptKern.h"
+
+using namespace AdaptOrg;
+
+//
+// Packed row helpers
+//
+
+static size_t PackedBytes (int Precision, int StateCount, int RowSize) {
+   size_t Values = (size_t) StateCount * RowSize;
+   size_t Bytes;
+
+   switch (Precision) {
+      case ADAPTBATCH_FLOAT16:
+      case ADAPTBATCH_BFLOAT16:
+         Bytes = 2 * Values;
+         break;
+
+      case ADAPTBATCH_INT8:
+         Bytes = sizeof (float) * StateCount + Values;
+         break;
+
+      default:
+         Bytes = sizeof (float) * Values;
+   }
+
+   // Each member's block starts on an aligned boundary:
+   return (Bytes + ADAPTAI_ALIGNMENT - 1) / ADAPTAI_ALIGNMENT * ADAPTAI_ALIGNMENT;
+}
+
+static void UnpackRow (int Precision, const char *Block, int StateCount, int RowSize, int Row, float *Out) {
+   size_t Offset = (size_t) Row * RowSize;
+
+   switch (Precision) {
+      case ADAPTBATCH_FLOAT16:
+         HalfToFloat ((const unsigned short *) Block + Offset, RowSize, Out);
+         break;
+
+      case ADAPTBATCH_BFLOAT16:
+         BFloatToFloat ((const unsigned short *) Block + Offset, RowSize, Out);
+         break;
+
+      case ADAPTBATCH_INT8:
+         DequantizeRow ((const signed char *) (Block + sizeof (float) * StateCount) + Offset, RowSize,
+                        ((const float *) Block) [Row], Out);
+         break;
+
+      default:
+         memcpy (Out, (const float *) Block + Offset, sizeof (float) * RowSize);
+   }
+}
+
+static void PackRow (int Precision, char *Block, int StateCount, int RowSize, int Row, const float *In) {
+   size_t Offset = (size_t) Row * RowSize;
+
+   switch (Precision) {
+      case ADAPTBATCH_FLOAT16:
+         FloatToHalf (In, RowSize, (unsigned short *) Block + Offset);
+         break;
+
+      case ADAPTBATCH_BFLOAT16:
+         FloatToBFloat (In, RowSize, (unsigned short *) Block + Offset);
+         break;
+
+      case ADAPTBATCH_INT8:
+         ((float *) Block) [Row] = QuantizeRow (In, RowSize, (signed char *) (Block + sizeof (float) * StateCount) + Offset);
+         break;
+
+      default:
+         memcpy ((float *) Block + Offset, In, sizeof (float) * RowSize);
+   }
+}
+
+//
+// OrganismBatch implementation
+//
+
+OrganismBatch::OrganismBatch () {
+   StateCount = SensorCount = Count = Capacity = 0;
+
+   Precision   = ADAPTBATCH_FLOAT32;
+   GenomeBytes = 0;
+
+   States = NULL;
+   Inputs = Coeff = NULL;
+
+   GeneChance = GeneRate = NULL;
+   RowCross   = NULL;
+
+   Rng = NULL;
+
+   Bound             = NULL;
+   BoundStride       = 0;
+   BoundSensorStride = 1;
+}
+
+OrganismBatch::OrganismBatch (const Organism *Orgs, int N) {
+   StateCount = SensorCount = Count = Capacity = 0;
+
+   Precision   = ADAPTBATCH_FLOAT32;
+   GenomeBytes = 0;
+
+   States = NULL;
+   Inputs = Coeff = NULL;
+
+   GeneChance = GeneRate = NULL;
+   RowCross   = NULL;
+
+   Rng = NULL;
+
+   Bound             = NULL;
+   BoundStride       = 0;
+   BoundSensorStride = 1;
+
+   for (int i = 0; i < N; i++) {
+      Add (Orgs [i]);
+
+      // The first organism fixes the shape, size everything after it:
+      if (i == 0)
+         Reserve (N);
+   }
+}
+
+OrganismBatch::OrganismBatch (const OrganismBatch &B) {
+   StateCount = SensorCount = Count = Capacity = 0;
+
+   Precision   = ADAPTBATCH_FLOAT32;
+   GenomeBytes = 0;
+
+   States = NULL;
+   Inputs = Coeff = NULL;
+
+   GeneChance = GeneRate = NULL;
+   RowCross   = NULL;
+
+   Rng = NULL;
+
+   Bound             = NULL;
+   BoundStride       = 0;
+   BoundSensorStride = 1;
+
+   (*this) = B;
+}
+
+OrganismBatch::~OrganismBatch () {
+   Free ();
+}
+
+bool OrganismBatch::Free () {
+   delete [] States;
+   delete [] Inputs;
+
+   FreeAligned (Coeff);
+
+   delete [] GeneChance;
+   delete [] GeneRate;
+   delete [] RowCross;
+
+   States = NULL;
+   Inputs = Coeff = NULL;
+
+   GeneChance = GeneRate = NULL;
+   RowCross   = NULL;
+
+   Count = Capacity = 0;
+
+   return true;
+}
+
+bool OrganismBatch::CacheFactors () {
+   delete [] GeneChance;
+   delete [] GeneRate;
+   delete [] RowCross;
+
+   GeneChance = new float [StateCount * StateCount + 1];
+   GeneRate   = new float [StateCount * StateCount + 1];
+   RowCross   = new bool  [StateCount + 1];
+
+   for (int i = 0; i < StateCount; i++) {
+      Chromosome &Chrom = Prototype.OrgGenome.GetChromosome (i);
+
+      RowCross [i] = Chrom.GetCrossoverState ();
+
+      for (int j = 0; j < StateCount; j++) {
+         GeneChance [i * StateCount + j] = Chrom.GetGene (j).GetMutationChance ();
+         GeneRate [i * StateCount + j]   = Chrom.GetGene (j).GetMutationRate ();
+      }
+   }
+
+   return true;
+}
+
+char *OrganismBatch::GetBlock (int Index) const {
+   return (char *) Coeff + (size_t) Index * GenomeBytes;
+}
+
+OrganismBatch &OrganismBatch::operator = (const OrganismBatch &B) {
+   if (this == &B)
+      return *this;
+
+   Free ();
+
+   StateCount  = B.StateCount;
+   SensorCount = B.SensorCount;
+   Precision   = B.Precision;
+   GenomeBytes = B.GenomeBytes;
+
+   Prototype = B.Prototype;
+
+   Reserve (B.Count);
+
+   Count = B.Count;
+
+   if (Count > 0) {
+      memcpy (States, B.States, sizeof (int) * Count);
+      memcpy (Inputs, B.Inputs, sizeof (float) * Count * SensorCount);
+      memcpy (Coeff,  B.Coeff,  GenomeBytes * Count);
+
+      CacheFactors ();
+   }
+
+   return *this;
+}
+
+bool OrganismBatch::Clear () {
+   Free ();
+
+   StateCount = SensorCount = 0;
+
+   GenomeBytes = 0;
+
+   Prototype = Organism ();
+
+   return true;
+}
+
+bool OrganismBatch::Reserve (int N) {
+   if (N <= Capacity)
+      return true;
+
+   int   *NewStates = new int   [N];
+   float *NewInputs = new float [(size_t) N * SensorCount + 1];
+   float *NewCoeff  = AllocateAligned ((size_t) N * GenomeBytes / sizeof (float));
+
+   if (Count > 0) {
+      memcpy (NewStates, States, sizeof (int) * Count);
+      memcpy (NewInputs, Inputs, sizeof (float) * Count * SensorCount);
+      memcpy (NewCoeff,  Coeff,  GenomeBytes * Count);
+   }
+
+   delete [] States;
+   delete [] Inputs;
+
+   FreeAligned (Coeff);
+
+   States   = NewStates;
+   Inputs   = NewInputs;
+   Coeff    = NewCoeff;
+   Capacity = N;
+
+   return true;
+}
+
+int OrganismBatch::Add (const Organism &Org) {
+   if (Org.StateCount != StateCount || Org.SensorCount != SensorCount) {
+      // Only an empty batch may take on a new shape:
+      if (Count > 0)
+         return -1;
+
+      Free ();
+
+      StateCount  = Org.StateCount;
+      SensorCount = Org.SensorCount;
+
+      GenomeBytes = PackedBytes (Precision, StateCount, StateCount * (1 + SensorCount));
+   }
+
+   if (Count == 0) {
+      Prototype = Org;
+
+      CacheFactors ();
+   }
+
+   if (Count == Capacity)
+      Reserve (Capacity < 16 ? 16 : 2 * Capacity);
+
+   int i, j;
+
+   States [Count] = Org.CurrentState;
+
+   float *In = Inputs + (size_t) Count * SensorCount;
+
+   for (i = 0; i < SensorCount; i++)
+      In [i] = Org.Sensors [i].Value;
+
+   int Stride  = 1 + SensorCount;
+   int RowSize = StateCount * Stride;
+
+   // Reduced precisions are gathered as floats first, then packed:
+   float *Block = (Precision == ADAPTBATCH_FLOAT32) ? (float *) GetBlock (Count) : new float [StateCount * RowSize + 1];
+
+   const float *Data = Org.OrgGenome.GetData ();
+
+   if (Data != NULL)
+      memcpy (Block, Data, sizeof (float) * StateCount * RowSize);
+   else {
+      for (i = 0; i < StateCount; i++) {
+         Chromosome &Chrom = Org.OrgGenome.GetChromosome (i);
+
+         for (j = 0; j < StateCount; j++) {
+            Gene &G = Chrom.GetGene (j);
+
+            for (int k = 0; k < Stride; k++)
+               Block [(i * StateCount + j) * Stride + k] = G.GetElement (k);
+         }
+      }
+   }
+
+   if (Precision != ADAPTBATCH_FLOAT32) {
+      for (i = 0; i < StateCount; i++)
+         PackRow (Precision, GetBlock (Count), StateCount, RowSize, i, Block + i * RowSize);
+
+      delete [] Block;
+   }
+
+   return Count++;
+}
+
+int OrganismBatch::GetCount () const {
+   return Count;
+}
+
+int OrganismBatch::GetStateCount () const {
+   return StateCount;
+}
+
+int OrganismBatch::GetSensorCount () const {
+   return SensorCount;
+}
+
+bool OrganismBatch::Store (int Index, Organism &Org) const {
+   if (Index < 0 || Index >= Count)
+      return false;
+
+   if (Org.StateCount != StateCount || Org.SensorCount != SensorCount)
+      return false;
+
+   int i, j;
+
+   Org.CurrentState = States [Index];
+
+   for (i = 0; i < SensorCount; i++)
+      Org.Sensors [i].SetValue (GetSensorValue (Index, i));
+
+   int Stride  = 1 + SensorCount;
+   int RowSize = StateCount * Stride;
+
+   float *Unpacked = NULL;
+
+   if (Precision != ADAPTBATCH_FLOAT32) {
+      Unpacked = new float [StateCount * RowSize + 1];
+
+      for (i = 0; i < StateCount; i++)
+         UnpackRow (Precision, GetBlock (Index), StateCount, RowSize, i, Unpacked + i * RowSize);
+   }
+
+   const float *Block = (Unpacked != NULL) ? Unpacked : (const float *) GetBlock (Index);
+
+   float *Data = Org.OrgGenome.GetData ();
+
+   if (Data != NULL)
+      memcpy (Data, Block, sizeof (float) * StateCount * RowSize);
+   else {
+      for (i = 0; i < StateCount; i++) {
+         for (j = 0; j < StateCount; j++) {
+            const float *G = Block + (i * StateCount + j) * Stride;
+
+            Org.SetTransition (i, j, G [0], G + 1);
+         }
+      }
+   }
+
+   delete [] Unpacked;
+
+   return Org.Invalidate ();
+}
+
+Organism OrganismBatch::Get (int Index) const {
+   Organism Temp = Prototype;
+
+   Store (Index, Temp);
+
+   return Temp;
+}
+
+int OrganismBatch::GetCurrentState (int Index) const {
+   if (Index < 0 || Index >= Count)
+      return -1;
+
+   return States [Index];
+}
+
+bool OrganismBatch::SetCurrentState (int Index, int State) {
+   if (Index < 0 || Index >= Count || State < 0 || State >= StateCount)
+      return false;
+
+   States [Index] = State;
+
+   return true;
+}
+
+float OrganismBatch::GetSensorValue (int Index, int Sensor) const {
+   if (Index < 0 || Index >= Count || Sensor < 0 || Sensor >= SensorCount)
+      return 0.0F;
+
+   if (Bound != NULL)
+      return Bound [(size_t) Index * BoundStride + (size_t) Sensor * BoundSensorStride];
+
+   return Inputs [(size_t) Index * SensorCount + Sensor];
+}
+
+bool OrganismBatch::SetSensorValue (int Index, int Sensor, float Value) {
+   if (Index < 0 || Index >= Count || Sensor < 0 || Sensor >= SensorCount || Bound != NULL)
+      return false;
+
+   Inputs [(size_t) Index * SensorCount + Sensor] = Value;
+
+   return true;
+}
+
+bool OrganismBatch::SetGenerator (Generator *G) {
+   Rng = G;
+
+   return true;
+}
+
+Generator &OrganismBatch::GetGenerator () const {
+   if (Rng != NULL)
+      return *Rng;
+
+   return AdaptAI::GetGenerator ();
+}
+
+bool OrganismBatch::BindSensors (const float *Inputs, int OrganismStride, int SensorStride) {
+   if (Inputs == NULL || OrganismStride < 0 || SensorStride < 1)
+      return false;
+
+   Bound             = Inputs;
+   BoundStride       = OrganismStride;
+   BoundSensorStride = SensorStride;
+
+   return true;
+}
+
+bool OrganismBatch::UnbindSensors () {
+   Bound             = NULL;
+   BoundStride       = 0;
+   BoundSensorStride = 1;
+
+   return true;
+}
+
+const float *OrganismBatch::GetBoundSensors () const {
+   return Bound;
+}
+
+const float *OrganismBatch::GetInputs (int Index, float *Scratch) const {
+   if (Bound != NULL && BoundSensorStride == 1)
+      return Bound + (size_t) Index * BoundStride;
+
+   if (Bound != NULL) {
+      const float *In = Bound + (size_t) Index * BoundStride;
+
+      for (int k = 0; k < SensorCount; k++)
+         Scratch [k] = In [(size_t) k * BoundSensorStride];
+
+      return Scratch;
+   }
+
+   return Inputs + (size_t) Index * SensorCount;
+}
+
+bool OrganismBatch::StepAll () {
+   return Step (0, Count, GetGenerator ());
+}
+
+bool OrganismBatch::Step (int First, int N) {
+   return Step (First, N, GetGenerator ());
+}
+
+bool OrganismBatch::Step (int First, int N, Generator &G) {
+   if (First < 0 || N < 0 || First + N > Count)
+      return false;
+
+   if (StateCount <= 0 || N == 0)
+      return true;
+
+   int Stride  = 1 + SensorCount;
+   int RowSize = StateCount * Stride;
+
+   // Ranges own their scratch space so they can be stepped from separate
+   // threads, each with its own generator. Reduced precisions unpack just
+   // the current row:
+   float *Weights  = new float [StateCount];
+   float *Unpacked = (Precision != ADAPTBATCH_FLOAT32) ? new float [RowSize] : NULL;
+   float *Gathered = (Bound != NULL && BoundSensorStride != 1) ? new float [SensorCount + 1] : NULL;
+
+   for (int i = First; i < First + N; i++) {
+      const float *Row;
+
+      if (Unpacked != NULL) {
+         UnpackRow (Precision, GetBlock (i), StateCount, RowSize, States [i], Unpacked);
+
+         Row = Unpacked;
+      }
+      else Row = (const float *) GetBlock (i) + States [i] * RowSize;
+
+      EvaluateRow (Row, StateCount, Stride, GetInputs (i, Gathered), SensorCount, Weights);
+
+      bool Monotone = CumulateRow (Weights, StateCount);
+
+      int Next = SampleCdf (Weights, StateCount, Monotone, G.Random ());
+
+      if (Next >= 0)
+         States [i] = Next;
+   }
+
+   delete [] Weights;
+   delete [] Unpacked;
+   delete [] Gathered;
+
+   return true;
+}
+
+bool OrganismBatch::SetPrecision (int P) {
+   if (P < ADAPTBATCH_FLOAT32 || P > ADAPTBATCH_INT8)
+      return false;
+
+   if (P == Precision)
+      return true;
+
+   int RowSize = StateCount * (1 + SensorCount);
+
+   size_t NewBytes = PackedBytes (P, StateCount, RowSize);
+
+   // Nothing allocated yet, only the member size changes:
+   if (Capacity == 0) {
+      Precision   = P;
+      GenomeBytes = NewBytes;
+
+      return true;
+   }
+
+   float *NewCoeff = AllocateAligned ((size_t) Capacity * NewBytes / sizeof (float));
+   float *Row      = new float [RowSize];
+
+   for (int i = 0; i < Count; i++) {
+      char *To = (char *) NewCoeff + (size_t) i * NewBytes;
+
+      for (int r = 0; r < StateCount; r++) {
+         UnpackRow (Precision, GetBlock (i), StateCount, RowSize, r, Row);
+
+         PackRow (P, To, StateCount, RowSize, r, Row);
+      }
+   }
+
+   delete [] Row;
+
+   FreeAligned (Coeff);
+
+   Coeff       = NewCoeff;
+   Precision   = P;
+   GenomeBytes = NewBytes;
+
+   return true;
+}
+
+int OrganismBatch::GetPrecision () const {
+   return Precision;
+}
+
+size_t OrganismBatch::GetGenomeBytes () const {
+   return GenomeBytes;
+}
+
+bool OrganismBatch::Mutate (int First, int N) {
+   return Mutate (First, N, GetGenerator ());
+}
+
+bool OrganismBatch::Mutate (int First, int N, Generator &G) {
+   if (First < 0 || N < 0 || First + N > Count)
+      return false;
+
+   if (StateCount <= 0 || N == 0)
+      return true;
+
+   int Stride  = 1 + SensorCount;
+   int RowSize = StateCount * Stride;
+
+   float *Unpacked = new float [RowSize];
+
+   for (int i = First; i < First + N; i++) {
+      char *Block = GetBlock (i);
+
+      // One cursor spans the member's genome, as in Genome::Mutate:
+      MutationCursor Cursor;
+
+      for (int r = 0; r < StateCount; r++) {
+         bool Packed = (Precision != ADAPTBATCH_FLOAT32), Loaded = !Packed;
+
+         // Chromosome::MutateChromosome's trait draw, kept so the stream
+         // stays in step with Organism::Mutate; the traits are shared:
+         G.Random ();
+
+         float *Row = Packed ? Unpacked : (float *) Block + r * RowSize;
+
+         for (int j = 0; j < StateCount; j++) {
+            int g = r * StateCount + j;
+
+            if (Cursor.Chance != GeneChance [g])
+               Cursor.Reset (GeneChance [g], G);
+
+            long long k = Cursor.Gap;
+
+            while (k < Stride) {
+               // Rows without a hit are never unpacked:
+               if (!Loaded) {
+                  UnpackRow (Precision, Block, StateCount, RowSize, r, Unpacked);
+
+                  Loaded = true;
+               }
+
+               Row [j * Stride + k] += (2.0F * G.Random () - 1.0F) * GeneRate [g];
+
+               k += 1 + Cursor.Draw (G);
+            }
+
+            Cursor.Gap = k - Stride;
+         }
+
+         if (Packed && Loaded)
+            PackRow (Precision, Block, StateCount, RowSize, r, Unpacked);
+      }
+   }
+
+   delete [] Unpacked;
+
+   return true;
+}
+
+bool OrganismBatch::Cross (int Parent1, int Parent2, int Child) {
+   return Cross (Parent1, Parent2, Child, GetGenerator ());
+}
+
+bool OrganismBatch::Cross (int Parent1, int Parent2, int Child, Generator &G) {
+   if (Parent1 < 0 || Parent1 >= Count || Parent2 < 0 || Parent2 >= Count || Child < 0 || Child >= Count)
+      return false;
+
+   int Stride  = 1 + SensorCount;
+   int RowSize = StateCount * Stride;
+
+   // Rows go through floats one at a time, so the child may be a parent
+   // and 8-bit rows get a scale that fits what they inherit:
+   float *A   = new float [3 * RowSize + 1];
+   float *B   = A + RowSize;
+   float *Out = B + RowSize;
+
+   for (int r = 0; r < StateCount; r++) {
+      UnpackRow (Precision, GetBlock (Parent1), StateCount, RowSize, r, A);
+      UnpackRow (Precision, GetBlock (Parent2), StateCount, RowSize, r, B);
+
+      // Chromosome::Cross's trait draw, likewise discarded:
+      G.Random ();
+
+      if (RowCross [r]) {
+         // 50% chance of inheriting each gene from either parent:
+         for (int j = 0; j < StateCount; j++)
+            memcpy (Out + j * Stride, (G.Random () < 0.5F) ? A + j * Stride : B + j * Stride, sizeof (float) * Stride);
+      }
+      else {
+         // Genes are numerical average of parents:
+         for (int k = 0; k < RowSize; k++)
+            Out [k] = (A [k] + B [k]) / 2.0F;
+      }
+
+      PackRow (Precision, GetBlock (Child), StateCount, RowSize, r, Out);
+   }
+
+   delete [] A;
+
+   States [Child] = 0;
+
+   if (Child != Parent1)
+      memcpy (Inputs + (size_t) Child * SensorCount, Inputs + (size_t) Parent1 * SensorCount, sizeof (float) * SensorCount);
+
+   return Mutate (Child, 1, G);
+}
@@ -0,0 +1,130 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptBatch.h
+  Purpose:      Declaration for the AdaptOrg organism batch.
+*****************************************************************************/
+
+#ifndef __ADAPTBATCHH__
+#define __ADAPTBATCHH__
+
+#include "AdaptOrg.h"
+
+// Coefficient storage precisions:
+#define ADAPTBATCH_FLOAT32  0
+#define ADAPTBATCH_FLOAT16  1
+#define ADAPTBATCH_BFLOAT16 2
+#define ADAPTBATCH_INT8     3
+
+namespace AdaptOrg {
+
+   // Many organisms of one shape stored as parallel arrays, so a whole crowd
+   // can be stepped in one pass:
+   //
+   //    States    Count                                   current states
+   //    Inputs    Count x SensorCount                     sensor values
+   //    Coeff     Count x StateCount x StateCount x (1 + SensorCount)
+   //
+   // Coeff holds floats, or in a reduced precision 16-bit values or 8-bit
+   // codes; 8-bit members start with one scale float per row (from-state).
+   // Names, mutation factors and crossover traits are shared: they are
+   // taken from the first organism added, both for mutating and crossing
+   // members and whenever a member is converted back.
+   class OrganismBatch {
+      protected:
+         int StateCount, SensorCount, Count, Capacity;
+
+         // Bytes per organism in Coeff, padded to the alignment:
+         int    Precision;
+         size_t GenomeBytes;
+
+         int   *States;
+         float *Inputs, *Coeff;
+
+         Organism Prototype;
+
+         // Prototype's mutation factors per gene and crossover trait per row:
+         float *GeneChance, *GeneRate;
+         bool  *RowCross;
+
+         // Random number source, NULL for the calling thread's generator:
+         Generator *Rng;
+
+         // Caller-owned inputs, organism i reading sensor k at
+         // Bound + i * BoundStride + k * BoundSensorStride, or NULL to use Inputs:
+         const float *Bound;
+         int         BoundStride, BoundSensorStride;
+
+         bool Free ();
+         bool CacheFactors ();
+
+         char *GetBlock (int Index) const;
+
+         // Organism Index's sensors, gathered into Scratch (SensorCount
+         // floats) when the bound ones aren't contiguous:
+         const float *GetInputs (int Index, float *Scratch) const;
+
+      public:
+         OrganismBatch  ();
+         OrganismBatch  (const Organism *Orgs, int N);
+         OrganismBatch  (const OrganismBatch &B);
+         ~OrganismBatch ();
+
+         OrganismBatch &operator = (const OrganismBatch &B);
+
+         bool Clear   ();
+         bool Reserve (int N);
+
+         int  Add (const Organism &Org);
+
+         int  GetCount       () const;
+         int  GetStateCount  () const;
+         int  GetSensorCount () const;
+
+         bool     Store (int Index, Organism &Org) const;
+         Organism Get   (int Index) const;
+
+         int  GetCurrentState (int Index) const;
+         bool SetCurrentState (int Index, int State);
+
+         float GetSensorValue (int Index, int Sensor) const;
+         bool  SetSensorValue (int Index, int Sensor, float Value);
+
+         bool       SetGenerator (Generator *G);
+         Generator &GetGenerator () const;
+
+         // Steps read straight from Inputs. OrganismStride is the distance
+         // between organisms, 0 having every organism observe the same values,
+         // and SensorStride the distance between one organism's sensors, as in
+         // Organism::BindSensors; a sensor-major array binds with (1, Count).
+         // While bound, SetSensorValue fails and the batch's own values are
+         // left untouched:
+         bool        BindSensors   (const float *Inputs, int OrganismStride, int SensorStride = 1);
+         bool        UnbindSensors ();
+         const float *GetBoundSensors () const;
+
+         bool StepAll ();
+         bool Step    (int First, int N);
+         bool Step    (int First, int N, Generator &G);
+
+         // Changing the precision converts every member. The reduced ones
+         // round to nearest, so going back to ADAPTBATCH_FLOAT32 doesn't
+         // restore the original values:
+         bool   SetPrecision   (int P);
+         int    GetPrecision   () const;
+         size_t GetGenomeBytes () const;
+
+         // Work on the stored precision a row at a time, with the shared
+         // factors and traits. Both make the same draws as Organism::Mutate
+         // and Organism::Cross, the per-row trait draws included but unused.
+         // Only averaged rows differ: an Organism child's averaged genes get
+         // the default factors, here they keep the shared ones. Child may be
+         // either parent:
+         bool Mutate (int First, int N);
+         bool Mutate (int First, int N, Generator &G);
+         bool Cross  (int Parent1, int Parent2, int Child);
+         bool Cross  (int Parent1, int Parent2, int Child, Generator &G);
+   };
+}
+
+#endif
@@ -0,0 +1,525 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptBench.cpp
+  Purpose:      Benchmarks for the AdaptOrg hot paths.
+
+  Build it on its own, it isn't part of the library:
+
+     g++ -std=c++17 -O2 -o AdaptBench AdaptBench.cpp AdaptAI.cpp AdaptBatch.cpp
+         AdaptChain.cpp AdaptKern.cpp AdaptMap.cpp AdaptOrg.cpp AdaptPool.cpp
+         AdaptPop.cpp AdaptRand.cpp AdaptSparse.cpp AdaptStore.cpp -lpthread
+
+  Usage:        AdaptBench [-time Seconds] [Filter] > Results.json
+
+  Runs every benchmark whose name contains Filter over a sweep of state
+  counts, sensor counts and population sizes, and writes one JSON object per
+  result line, so two runs diff line by line. Progress goes to stderr.
+
+  Each result has the throughput, the 50th, 90th and 99th percentile of the
+  time per operation over samples of a fixed batch of operations, and the
+  heap allocations per operation, counted by replacing operator new. On
+  Linux, cycles, instructions and cache misses per operation come from
+  perf_event_open, for the calling thread only, and are null when the
+  kernel won't give them.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "AdaptOrg.h"
+#include "AdaptPop.h"
+
+using namespace AdaptOrg;
+
+// Scratch file for the Save and Load benchmarks:
+#define ADAPTBENCH_FILE "AdaptBench.tmp"
+
+// Shortest sample worth timing, in nanoseconds, and fewest samples to take:
+#define ADAPTBENCH_SAMPLE  2000.0
+#define ADAPTBENCH_SAMPLES 50
+
+//
+// Allocation counting
+//
+
+static std::atomic<long long> Allocations (0), AllocatedBytes (0);
+
+void *operator new (size_t Size) {
+   Allocations.fetch_add (1, std::memory_order_relaxed);
+   AllocatedBytes.fetch_add ((long long) Size, std::memory_order_relaxed);
+
+   void *Block = malloc (Size ? Size : 1);
+
+   if (Block == NULL)
+      throw std::bad_alloc ();
+
+   return Block;
+}
+
+void *operator new [] (size_t Size) {
+   return operator new (Size);
+}
+
+void operator delete (void *Block) noexcept {
+   free (Block);
+}
+
+void operator delete [] (void *Block) noexcept {
+   free (Block);
+}
+
+void operator delete (void *Block, size_t) noexcept {
+   free (Block);
+}
+
+void operator delete [] (void *Block, size_t) noexcept {
+   free (Block);
+}
+
+//
+// Counters implementation
+//
+
+// Hardware counters for the calling thread, where the kernel allows them:
+class Counters {
+   protected:
+      enum { Cycles, Instructions, CacheMisses, Count };
+
+      int Fd [Count];
+
+   public:
+      Counters  ();
+      ~Counters ();
+
+      bool Available () const;
+
+      bool Start ();
+      bool Stop  (long long *Values);
+};
+
+Counters::Counters () {
+   for (int i = 0; i < Count; i++)
+      Fd [i] = -1;
+
+#ifdef __linux__
+   static const unsigned long long Config [Count] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+   };
+
+   for (int i = 0; i < Count; i++) {
+      perf_event_attr Attr;
+
+      memset (&Attr, 0, sizeof (Attr));
+
+      Attr.type           = PERF_TYPE_HARDWARE;
+      Attr.size           = sizeof (Attr);
+      Attr.config         = Config [i];
+      Attr.disabled       = 1;
+      Attr.exclude_kernel = 1;
+      Attr.exclude_hv     = 1;
+
+      Fd [i] = (int) syscall (SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+
+      // All or nothing, so the columns always mean the same thing:
+      if (Fd [i] < 0) {
+         for (int j = 0; j < i; j++) {
+            close (Fd [j]);
+
+            Fd [j] = -1;
+         }
+
+         break;
+      }
+   }
+#endif
+}
+
+Counters::~Counters () {
+#ifdef __linux__
+   for (int i = 0; i < Count; i++) {
+      if (Fd [i] >= 0)
+         close (Fd [i]);
+   }
+#endif
+}
+
+bool Counters::Available () const {
+   return Fd [0] >= 0;
+}
+
+bool Counters::Start () {
+   if (!Available ())
+      return false;
+
+#ifdef __linux__
+   for (int i = 0; i < Count; i++) {
+      ioctl (Fd [i], PERF_EVENT_IOC_RESET, 0);
+      ioctl (Fd [i], PERF_EVENT_IOC_ENABLE, 0);
+   }
+#endif
+
+   return true;
+}
+
+bool Counters::Stop (long long *Values) {
+   if (!Available ())
+      return false;
+
+#ifdef __linux__
+   for (int i = 0; i < Count; i++)
+      ioctl (Fd [i], PERF_EVENT_IOC_DISABLE, 0);
+
+   for (int i = 0; i < Count; i++) {
+      if (read (Fd [i], &Values [i], sizeof (long long)) != sizeof (long long))
+         return false;
+   }
+#endif
+
+   return true;
+}
+
+//
+// Bench implementation
+//
+
+class Bench {
+   protected:
+      std::string Filter;
+
+      double MinSeconds;
+
+      Counters Hardware;
+
+      bool First;
+
+      static double Now ();
+
+      // A JSON number, or null when not measured:
+      static std::string Number (double Value, bool Valid = true);
+
+   public:
+      Bench (const std::string &F, double Seconds);
+
+      bool HasCounters () const;
+
+      // Times Op, one call being one operation, and writes a result line:
+      bool Run (const char *Name, int States, int Sensors, int Members, const std::function<void ()> &Op);
+
+      bool Finish ();
+};
+
+Bench::Bench (const std::string &F, double Seconds) {
+   Filter     = F;
+   MinSeconds = Seconds;
+   First      = true;
+}
+
+double Bench::Now () {
+   return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+std::string Bench::Number (double Value, bool Valid) {
+   if (!Valid)
+      return "null";
+
+   char Text [64];
+
+   snprintf (Text, sizeof (Text), "%.6g", Value);
+
+   return Text;
+}
+
+bool Bench::HasCounters () const {
+   return Hardware.Available ();
+}
+
+bool Bench::Run (const char *Name, int States, int Sensors, int Members, const std::function<void ()> &Op) {
+   if (!Filter.empty () && strstr (Name, Filter.c_str ()) == NULL)
+      return false;
+
+   fprintf (stderr, "%s states %d sensors %d members %d\n", Name, States, Sensors, Members);
+
+   // Warm up, and size a batch so a sample is long enough to time:
+   int    Calls = 0;
+   double Begin = Now (), Spent;
+
+   do {
+      Op ();
+
+      Calls++;
+
+      Spent = Now () - Begin;
+   } while (Spent < MinSeconds * 1e9 / 10 && Calls < 1000000);
+
+   long long Batch = (long long) (ADAPTBENCH_SAMPLE / (Spent / Calls)) + 1;
+
+   // Room for every sample up front, so only Op's allocations are counted:
+   std::vector<double> Samples;
+
+   Samples.reserve ((size_t) (MinSeconds * 1e9 / ADAPTBENCH_SAMPLE) + 2 * ADAPTBENCH_SAMPLES);
+
+   long long StartAllocs = Allocations.load (), StartBytes = AllocatedBytes.load ();
+   long long Values [3] = {0, 0, 0};
+
+   bool Counted = Hardware.Start ();
+
+   double Total = 0.0;
+
+   while (Total < MinSeconds * 1e9 || (int) Samples.size () < ADAPTBENCH_SAMPLES) {
+      double Start = Now ();
+
+      for (long long k = 0; k < Batch; k++)
+         Op ();
+
+      double Time = Now () - Start;
+
+      Samples.push_back (Time / Batch);
+
+      Total += Time;
+   }
+
+   if (Counted)
+      Counted = Hardware.Stop (Values);
+
+   double Ops    = (double) Batch * Samples.size ();
+   double Allocs = (double) (Allocations.load () - StartAllocs);
+   double Bytes  = (double) (AllocatedBytes.load () - StartBytes);
+
+   std::sort (Samples.begin (), Samples.end ());
+
+   auto Percentile = [&Samples] (double P) {
+      size_t i = (size_t) (P * (Samples.size () - 1) + 0.5);
+
+      return Samples [i];
+   };
+
+   printf ("%s    {\"name\": \"%s\", \"states\": %d, \"sensors\": %d, \"members\": %d, "
+           "\"ops\": %.0f, \"ns_per_op\": %s, \"ops_per_sec\": %s, "
+           "\"p50_ns\": %s, \"p90_ns\": %s, \"p99_ns\": %s, "
+           "\"allocs_per_op\": %s, \"bytes_per_op\": %s, "
+           "\"cycles_per_op\": %s, \"instructions_per_op\": %s, \"cache_misses_per_op\": %s}",
+           First ? "" : ",\n", Name, States, Sensors, Members, Ops,
+           Number (Total / Ops).c_str (), Number (Ops * 1e9 / Total).c_str (),
+           Number (Percentile (0.50)).c_str (), Number (Percentile (0.90)).c_str (), Number (Percentile (0.99)).c_str (),
+           Number (Allocs / Ops).c_str (), Number (Bytes / Ops).c_str (),
+           Number (Values [0] / Ops, Counted).c_str (), Number (Values [1] / Ops, Counted).c_str (),
+           Number (Values [2] / Ops, Counted).c_str ());
+
+   fflush (stdout);
+
+   First = false;
+
+   return true;
+}
+
+bool Bench::Finish () {
+   printf ("\n  ]\n}\n");
+
+   return true;
+}
+
+//
+// Benchmarks
+//
+
+// Fully connected, with coefficients that depend on the position:
+static Organism Build (int States, int Sensors) {
+   Organism Org;
+
+   Org.SetStateCount (States);
+   Org.SetSensorCount (Sensors);
+
+   std::vector<float> Coeff (Sensors);
+
+   for (int i = 0; i < States; i++) {
+      for (int j = 0; j < States; j++) {
+         for (int k = 0; k < Sensors; k++)
+            Coeff [k] = 0.1F * ((i + j + k) % 7) - 0.2F;
+
+         Org.SetTransition (i, j, 1.0F + (i * j) % 5, Coeff.data ());
+      }
+   }
+
+   for (int k = 0; k < Sensors; k++)
+      Org.SetSensorValue (k, 0.5F);
+
+   return Org;
+}
+
+static Gene BuildGene (int Length, float Chance) {
+   Gene G;
+
+   G.SetLength (Length);
+   G.SetMutationChance (Chance);
+   G.SetMutationRate (0.1F);
+
+   for (int i = 0; i < Length; i++)
+      G.SetElement (i, 0.01F * i);
+
+   return G;
+}
+
+static Chromosome BuildChromosome (int Genes, int Length) {
+   Chromosome Chrom;
+
+   Chrom.SetGeneCount (Genes);
+
+   for (int i = 0; i < Genes; i++)
+      Chrom.SetGene (i, BuildGene (Length, 0.01F));
+
+   return Chrom;
+}
+
+static void OrganismBenchmarks (Bench &B, int States, int Sensors) {
+   Philox Rng (1);
+
+   Organism Org = Build (States, Sensors), Mate = Build (States, Sensors), Child;
+
+   Org.SetGenerator (&Rng);
+
+   B.Run ("Organism::UpdateState", States, Sensors, 0, [&] () {
+      Org.UpdateState ();
+   });
+
+   B.Run ("Organism::Mutate", States, Sensors, 0, [&] () {
+      Org.Mutate (Rng);
+   });
+
+   B.Run ("Organism::Cross", States, Sensors, 0, [&] () {
+      Org.Cross (Mate, Child, Rng);
+   });
+
+   B.Run ("Organism::operator=", States, Sensors, 0, [&] () {
+      Child = Mate;
+   });
+
+   std::fstream File (ADAPTBENCH_FILE, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+   B.Run ("Organism::Save", States, Sensors, 0, [&] () {
+      File.seekp (0);
+
+      Org.Save (File);
+   });
+
+   File.seekp (0);
+
+   Org.Save (File);
+   File.flush ();
+
+   B.Run ("Organism::Load", States, Sensors, 0, [&] () {
+      File.clear ();
+      File.seekg (0);
+
+      Child.Load (File);
+   });
+}
+
+static void GeneBenchmarks (Bench &B, int States, int Sensors) {
+   Philox Rng (2);
+
+   // A transition's gene, one coefficient per sensor plus the base chance:
+   Gene G = BuildGene (Sensors + 1, 0.05F);
+
+   B.Run ("Gene::Mutate", States, Sensors, 0, [&] () {
+      G.Mutate (Rng);
+   });
+
+   // A state's row of transitions:
+   Chromosome A = BuildChromosome (States, Sensors + 1), C = BuildChromosome (States, Sensors + 1);
+
+   B.Run ("Chromosome::operator+", States, Sensors, 0, [&] () {
+      Chromosome Sum = A + C;
+   });
+}
+
+static void PopulationBenchmarks (Bench &B, ThreadPool &Pool, int States, int Sensors, int Members) {
+   Population Pop;
+
+   Pop.SetThreadPool (&Pool);
+   Pop.SetSeed (3);
+   Pop.SetFitnessCache (false);
+   Pop.Populate (Build (States, Sensors), Members);
+
+   // Cheap enough that breeding still shows:
+   Pop.SetFitnessFunction ([States] (Organism &Org, Generator &) {
+      int Hits = 0;
+
+      Org.SetCurrentState (0);
+
+      for (int s = 0; s < 32; s++) {
+         Org.UpdateState ();
+
+         Hits += (Org.GetCurrentState () == States - 1);
+      }
+
+      return (float) Hits;
+   });
+
+   B.Run ("Population::Evolve", States, Sensors, Members, [&] () {
+      Pop.Evaluate ();
+      Pop.Evolve ();
+   });
+}
+
+int main (int argc, char *argv []) {
+   std::string Filter;
+
+   double Seconds = 0.25;
+
+   for (int i = 1; i < argc; i++) {
+      if (strcmp (argv [i], "-time") == 0 && i + 1 < argc)
+         Seconds = atof (argv [++i]);
+      else
+         Filter = argv [i];
+   }
+
+   if (Seconds <= 0.0) {
+      fprintf (stderr, "Usage: AdaptBench [-time Seconds] [Filter]\n");
+
+      return 1;
+   }
+
+   ThreadPool Pool;
+
+   Bench B (Filter, Seconds);
+
+   printf ("{\n  \"threads\": %d,\n  \"counters\": %s,\n  \"seconds\": %g,\n  \"results\": [\n",
+           Pool.GetThreadCount (), B.HasCounters () ? "true" : "false", Seconds);
+
+   static const int StateSweep [] = {8, 32, 128}, SensorSweep [] = {2, 8}, MemberSweep [] = {64, 256};
+
+   for (int States : StateSweep) {
+      for (int Sensors : SensorSweep) {
+         OrganismBenchmarks (B, States, Sensors);
+         GeneBenchmarks (B, States, Sensors);
+      }
+   }
+
+   for (int States : {8, 32}) {
+      for (int Members : MemberSweep)
+         PopulationBenchmarks (B, Pool, States, 2, Members);
+   }
+
+   B.Finish ();
+
+   remove (ADAPTBENCH_FILE);
+
+   return 0;
+}
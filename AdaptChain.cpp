@@ -0,0 +1,690 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptChain.cpp
+  Purpose:      Implementation for the AdaptOrg Markov chain analysis.
+*****************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "AdaptChain.h"
+#include "AdaptKern.h"
+
+using namespace AdaptOrg;
+
+//
+// TransitionMatrix implementation
+//
+
+TransitionMatrix::TransitionMatrix () {
+   StateCount = 0;
+
+   Matrix = NULL;
+   Cached = NULL;
+
+   CachedSteps = -1;
+
+   Pool    = NULL;
+   OwnPool = false;
+}
+
+TransitionMatrix::TransitionMatrix (const TransitionMatrix &T) {
+   StateCount = 0;
+
+   Matrix = NULL;
+   Cached = NULL;
+
+   CachedSteps = -1;
+
+   Pool    = NULL;
+   OwnPool = false;
+
+   (*this) = T;
+}
+
+TransitionMatrix::~TransitionMatrix () {
+   Free ();
+
+   if (OwnPool)
+      delete Pool;
+}
+
+TransitionMatrix &TransitionMatrix::operator = (const TransitionMatrix &T) {
+   if (this == &T)
+      return *this;
+
+   Free ();
+
+   StateCount  = T.StateCount;
+   CachedSteps = T.CachedSteps;
+
+   size_t Size = (size_t) StateCount * StateCount;
+
+   if (T.Matrix != NULL) {
+      Matrix = new double [Size];
+      Cached = new double [Size];
+
+      memcpy (Matrix, T.Matrix, sizeof (double) * Size);
+      memcpy (Cached, T.Cached, sizeof (double) * Size);
+   }
+
+   // Borrowed pools are shared, an owned one stays with its matrix:
+   if (!T.OwnPool)
+      SetThreadPool (T.Pool);
+
+   return *this;
+}
+
+bool TransitionMatrix::Free () {
+   delete [] Matrix;
+   delete [] Cached;
+
+   Matrix = NULL;
+   Cached = NULL;
+
+   StateCount  = 0;
+   CachedSteps = -1;
+
+   return true;
+}
+
+bool TransitionMatrix::GetPool () {
+   if (Pool == NULL) {
+      Pool    = new ThreadPool ();
+      OwnPool = true;
+   }
+
+   return true;
+}
+
+bool TransitionMatrix::SetThreadPool (ThreadPool *P) {
+   if (OwnPool)
+      delete Pool;
+
+   Pool    = P;
+   OwnPool = false;
+
+   return true;
+}
+
+bool TransitionMatrix::Build (const Organism &Org) {
+   std::vector<float> Inputs (Org.GetSensorCount () + 1);
+
+   for (int i = 0; i < Org.GetSensorCount (); i++)
+      Inputs [i] = Org.GetSensorValue (i);
+
+   return Build (Org, Inputs.data ());
+}
+
+bool TransitionMatrix::Build (const Organism &Org, const float *Inputs) {
+   int S = Org.GetStateCount ();
+
+   if (S <= 0 || (Inputs == NULL && Org.GetSensorCount () > 0))
+      return false;
+
+   if (S != StateCount) {
+      Free ();
+
+      StateCount = S;
+
+      Matrix = new double [(size_t) S * S];
+      Cached = new double [(size_t) S * S];
+   }
+
+   CachedSteps = -1;
+
+   float *Weights = new float [S];
+
+   for (int i = 0; i < S; i++) {
+      Org.EvaluateState (i, Inputs, Weights);
+
+      CumulateRow (Weights, S);
+
+      float Total = Weights [S - 1];
+
+      double *Row = Matrix + (size_t) i * S;
+
+      // SampleCdf takes the first state whose normalized running sum
+      // reaches the draw, so each state gets whatever its sum adds above
+      // the highest level reached so far:
+      double Covered = 0.0;
+
+      for (int j = 0; j < S; j++) {
+         float  Level = Weights [j] / Total;
+         double Reach = (Level > 0.0F) ? std::min ((double) Level, 1.0) : 0.0;
+
+         Row [j] = (Reach > Covered) ? Reach - Covered : 0.0;
+
+         Covered = std::max (Covered, Reach);
+      }
+
+      // Draws past every level sample -1, which leaves the state alone:
+      Row [i] += 1.0 - Covered;
+   }
+
+   delete [] Weights;
+
+   return true;
+}
+
+int TransitionMatrix::GetStateCount () const {
+   return StateCount;
+}
+
+double TransitionMatrix::GetProbability (int From, int To) const {
+   if (From < 0 || From >= StateCount || To < 0 || To >= StateCount)
+      return 0.0;
+
+   return Matrix [(size_t) From * StateCount + To];
+}
+
+const double *TransitionMatrix::GetData () const {
+   return Matrix;
+}
+
+bool TransitionMatrix::Multiply (const double *A, const double *B, double *C) {
+   int S = StateCount;
+
+   int Blocks = (S + ADAPTCHAIN_BLOCK - 1) / ADAPTCHAIN_BLOCK;
+
+   ThreadPool::Function Body = [=] (int First, int Last) {
+      for (int b = First; b < Last; b++) {
+         int i0 = b * ADAPTCHAIN_BLOCK, i1 = std::min (i0 + ADAPTCHAIN_BLOCK, S);
+
+         memset (C + (size_t) i0 * S, 0, sizeof (double) * (size_t) (i1 - i0) * S);
+
+         // One tile of A against one tile of B at a time, so both stay in
+         // cache while the row of C accumulates:
+         for (int k0 = 0; k0 < S; k0 += ADAPTCHAIN_BLOCK) {
+            int k1 = std::min (k0 + ADAPTCHAIN_BLOCK, S);
+
+            for (int j0 = 0; j0 < S; j0 += ADAPTCHAIN_BLOCK) {
+               int j1 = std::min (j0 + ADAPTCHAIN_BLOCK, S);
+
+               for (int i = i0; i < i1; i++) {
+                  const double *RowA = A + (size_t) i * S;
+                  double       *RowC = C + (size_t) i * S;
+
+                  for (int k = k0; k < k1; k++) {
+                     double a = RowA [k];
+
+                     // Transition matrices are mostly zeros:
+                     if (a == 0.0)
+                        continue;
+
+                     const double *RowB = B + (size_t) k * S;
+
+                     for (int j = j0; j < j1; j++)
+                        RowC [j] += a * RowB [j];
+                  }
+               }
+            }
+         }
+      }
+   };
+
+   // Each row block is summed in the same order whatever thread runs it:
+   if (Blocks > 1) {
+      GetPool ();
+
+      Pool->ParallelFor (Blocks, Body, 1);
+   }
+   else Body (0, Blocks);
+
+   return true;
+}
+
+bool TransitionMatrix::Iterate (const double *Initial, int Steps, double *Dist) const {
+   int S = StateCount;
+
+   double *Next = new double [S];
+
+   memmove (Dist, Initial, sizeof (double) * S);
+
+   for (int t = 0; t < Steps; t++) {
+      memset (Next, 0, sizeof (double) * S);
+
+      for (int i = 0; i < S; i++) {
+         double p = Dist [i];
+
+         if (p == 0.0)
+            continue;
+
+         const double *Row = Matrix + (size_t) i * S;
+
+         for (int j = 0; j < S; j++)
+            Next [j] += p * Row [j];
+      }
+
+      memcpy (Dist, Next, sizeof (double) * S);
+   }
+
+   delete [] Next;
+
+   return true;
+}
+
+bool TransitionMatrix::Power (int Steps, double *Result) {
+   if (Matrix == NULL || Steps < 0)
+      return false;
+
+   int    S    = StateCount;
+   size_t Size = (size_t) S * S;
+
+   if (Steps != CachedSteps) {
+      CachedSteps = -1;
+
+      if (Steps == 0) {
+         memset (Cached, 0, sizeof (double) * Size);
+
+         for (int i = 0; i < S; i++)
+            Cached [(size_t) i * S + i] = 1.0;
+      }
+      else {
+         double *Base = new double [Size];
+         double *Temp = new double [Size];
+
+         memcpy (Base, Matrix, sizeof (double) * Size);
+
+         bool Started = false;
+
+         // Cached accumulates P^(2^b) for every set bit b of Steps:
+         for (int k = Steps; k > 0; k >>= 1) {
+            if (k & 1) {
+               if (Started) {
+                  Multiply (Cached, Base, Temp);
+
+                  std::swap (Cached, Temp);
+               }
+               else memcpy (Cached, Base, sizeof (double) * Size);
+
+               Started = true;
+            }
+
+            if (k > 1) {
+               Multiply (Base, Base, Temp);
+
+               std::swap (Base, Temp);
+            }
+         }
+
+         delete [] Base;
+         delete [] Temp;
+      }
+
+      CachedSteps = Steps;
+   }
+
+   if (Result != NULL)
+      memcpy (Result, Cached, sizeof (double) * Size);
+
+   return true;
+}
+
+bool TransitionMatrix::Distribution (const double *Initial, int Steps, double *Dist) {
+   if (Matrix == NULL || Initial == NULL || Dist == NULL || Steps < 0)
+      return false;
+
+   int S = StateCount;
+
+   // Stepping the vector is cheaper until Steps nears StateCount:
+   if (Steps != CachedSteps && Steps < S)
+      return Iterate (Initial, Steps, Dist);
+
+   Power (Steps, NULL);
+
+   double *Sum = new double [S];
+
+   memset (Sum, 0, sizeof (double) * S);
+
+   for (int i = 0; i < S; i++) {
+      double p = Initial [i];
+
+      if (p == 0.0)
+         continue;
+
+      const double *Row = Cached + (size_t) i * S;
+
+      for (int j = 0; j < S; j++)
+         Sum [j] += p * Row [j];
+   }
+
+   memcpy (Dist, Sum, sizeof (double) * S);
+
+   delete [] Sum;
+
+   return true;
+}
+
+bool TransitionMatrix::Distribution (int From, int Steps, double *Dist) {
+   if (Matrix == NULL || From < 0 || From >= StateCount || Dist == NULL || Steps < 0)
+      return false;
+
+   int S = StateCount;
+
+   if (Steps != CachedSteps && Steps < S) {
+      memset (Dist, 0, sizeof (double) * S);
+
+      Dist [From] = 1.0;
+
+      return Iterate (Dist, Steps, Dist);
+   }
+
+   Power (Steps, NULL);
+
+   memcpy (Dist, Cached + (size_t) From * S, sizeof (double) * S);
+
+   return true;
+}
+
+int TransitionMatrix::FastForward (int From, int Steps, Generator &G) {
+   if (Matrix == NULL || From < 0 || From >= StateCount || Steps < 0)
+      return -1;
+
+   int S = StateCount;
+
+   const double *Row;
+   double       *Dist = NULL;
+
+   if (Steps != CachedSteps && Steps < S) {
+      Dist = new double [S];
+
+      Distribution (From, Steps, Dist);
+
+      Row = Dist;
+   }
+   else {
+      Power (Steps, NULL);
+
+      Row = Cached + (size_t) From * S;
+   }
+
+   double Choice = G.Random ();
+   double Sum    = 0.0;
+
+   int Next = -1;
+
+   for (int j = 0; j < S; j++) {
+      if (Row [j] <= 0.0)
+         continue;
+
+      Sum  += Row [j];
+      Next = j;
+
+      if (Choice <= Sum)
+         break;
+   }
+
+   // Rounding can leave the total a hair under 1, Next is then the last
+   // reachable state:
+   delete [] Dist;
+
+   return Next;
+}
+
+bool TransitionMatrix::FastForward (Organism &Org, int Steps) {
+   if (Org.GetStateCount () != StateCount)
+      return false;
+
+   int Next = FastForward (Org.GetCurrentState (), Steps, Org.GetGenerator ());
+
+   if (Next < 0)
+      return false;
+
+   return Org.SetCurrentState (Next);
+}
+
+bool TransitionMatrix::Solve (double *A, double *B, int N) {
+   int i, j, k;
+
+   for (k = 0; k < N; k++) {
+      int Pivot = k;
+
+      for (i = k + 1; i < N; i++) {
+         if (fabs (A [(size_t) i * N + k]) > fabs (A [(size_t) Pivot * N + k]))
+            Pivot = i;
+      }
+
+      if (!(fabs (A [(size_t) Pivot * N + k]) > 1e-12))
+         return false;
+
+      if (Pivot != k) {
+         for (j = 0; j < N; j++)
+            std::swap (A [(size_t) k * N + j], A [(size_t) Pivot * N + j]);
+
+         std::swap (B [k], B [Pivot]);
+      }
+
+      double *RowK = A + (size_t) k * N;
+
+      for (i = k + 1; i < N; i++) {
+         double *RowI = A + (size_t) i * N;
+
+         double f = RowI [k] / RowK [k];
+
+         if (f == 0.0)
+            continue;
+
+         for (j = k; j < N; j++)
+            RowI [j] -= f * RowK [j];
+
+         B [i] -= f * B [k];
+      }
+   }
+
+   for (k = N - 1; k >= 0; k--) {
+      double Sum = B [k];
+
+      for (j = k + 1; j < N; j++)
+         Sum -= A [(size_t) k * N + j] * B [j];
+
+      B [k] = Sum / A [(size_t) k * N + k];
+   }
+
+   return true;
+}
+
+bool TransitionMatrix::Stationary (double *Pi) const {
+   if (Matrix == NULL || Pi == NULL)
+      return false;
+
+   int i, j, S = StateCount;
+
+   // Pi (P - I) = 0 transposed, with the last equation swapped for
+   // sum (Pi) = 1 since the balance equations are one short of full rank:
+   double *A = new double [(size_t) S * S];
+
+   for (i = 0; i < S; i++) {
+      for (j = 0; j < S; j++)
+         A [(size_t) i * S + j] = Matrix [(size_t) j * S + i] - ((i == j) ? 1.0 : 0.0);
+
+      Pi [i] = 0.0;
+   }
+
+   for (j = 0; j < S; j++)
+      A [(size_t) (S - 1) * S + j] = 1.0;
+
+   Pi [S - 1] = 1.0;
+
+   bool Solved = Solve (A, Pi, S);
+
+   delete [] A;
+
+   if (!Solved)
+      return false;
+
+   // Clear rounding noise so the result is a proper distribution:
+   double Total = 0.0;
+
+   for (i = 0; i < S; i++) {
+      if (Pi [i] < 0.0)
+         Pi [i] = 0.0;
+
+      Total += Pi [i];
+   }
+
+   for (i = 0; i < S; i++)
+      Pi [i] /= Total;
+
+   return true;
+}
+
+bool TransitionMatrix::Stationary (double *Pi, const double *Initial, int MaxIterations, double Tolerance) const {
+   if (Matrix == NULL || Pi == NULL)
+      return false;
+
+   int i, j, S = StateCount;
+
+   for (i = 0; i < S; i++)
+      Pi [i] = (Initial != NULL) ? Initial [i] : 1.0 / S;
+
+   double *Next = new double [S];
+
+   bool Converged = false;
+
+   for (int t = 0; t < MaxIterations && !Converged; t++) {
+      // Half a step of P and half of standing still, so periodic chains
+      // settle too without moving the fixed point:
+      for (j = 0; j < S; j++)
+         Next [j] = 0.5 * Pi [j];
+
+      for (i = 0; i < S; i++) {
+         double p = 0.5 * Pi [i];
+
+         if (p == 0.0)
+            continue;
+
+         const double *Row = Matrix + (size_t) i * S;
+
+         for (j = 0; j < S; j++)
+            Next [j] += p * Row [j];
+      }
+
+      double Change = 0.0;
+
+      for (j = 0; j < S; j++) {
+         Change += fabs (Next [j] - Pi [j]);
+
+         Pi [j] = Next [j];
+      }
+
+      Converged = (Change <= Tolerance);
+   }
+
+   delete [] Next;
+
+   return Converged;
+}
+
+bool TransitionMatrix::HittingTimes (const int *Targets, int Count, double *Times) const {
+   if (Matrix == NULL || Targets == NULL || Times == NULL || Count <= 0)
+      return false;
+
+   int i, j, S = StateCount;
+
+   // 1 = target, 2 = reaches a target, 3 = may wander off for good:
+   std::vector<char> Kind (S, 0);
+   std::vector<int>  Queue;
+
+   for (i = 0; i < Count; i++) {
+      if (Targets [i] < 0 || Targets [i] >= S)
+         return false;
+
+      if (Kind [Targets [i]] == 0)
+         Queue.push_back (Targets [i]);
+
+      Kind [Targets [i]] = 1;
+   }
+
+   // Walk back from the targets to every state that can get there:
+   for (size_t q = 0; q < Queue.size (); q++) {
+      j = Queue [q];
+
+      for (i = 0; i < S; i++) {
+         if (Kind [i] == 0 && Matrix [(size_t) i * S + j] > 0.0) {
+            Kind [i] = 2;
+
+            Queue.push_back (i);
+         }
+      }
+   }
+
+   // States that can't reach a target, and every non-target state that can
+   // step into one of them, never arrive for sure:
+   Queue.clear ();
+
+   for (i = 0; i < S; i++) {
+      if (Kind [i] == 0) {
+         Kind [i] = 3;
+
+         Queue.push_back (i);
+      }
+   }
+
+   for (size_t q = 0; q < Queue.size (); q++) {
+      j = Queue [q];
+
+      for (i = 0; i < S; i++) {
+         if (Kind [i] == 2 && Matrix [(size_t) i * S + j] > 0.0) {
+            Kind [i] = 3;
+
+            Queue.push_back (i);
+         }
+      }
+   }
+
+   // What's left arrives with probability 1, solve (I - Q) h = 1 over it:
+   std::vector<int> Index (S, -1), Member;
+
+   for (i = 0; i < S; i++) {
+      if (Kind [i] == 2) {
+         Index [i] = (int) Member.size ();
+
+         Member.push_back (i);
+      }
+   }
+
+   int N = (int) Member.size ();
+
+   bool Solved = true;
+
+   if (N > 0) {
+      double *A = new double [(size_t) N * N];
+      double *H = new double [N];
+
+      for (int a = 0; a < N; a++) {
+         const double *Row = Matrix + (size_t) Member [a] * S;
+
+         for (int b = 0; b < N; b++)
+            A [(size_t) a * N + b] = ((a == b) ? 1.0 : 0.0) - Row [Member [b]];
+
+         H [a] = 1.0;
+      }
+
+      Solved = Solve (A, H, N);
+
+      for (i = 0; i < S; i++) {
+         if (Index [i] >= 0)
+            Times [i] = H [Index [i]];
+      }
+
+      delete [] A;
+      delete [] H;
+   }
+
+   for (i = 0; i < S; i++) {
+      if (Kind [i] == 1)
+         Times [i] = 0.0;
+      else if (Kind [i] == 3)
+         Times [i] = INFINITY;
+   }
+
+   return Solved;
+}
+
+bool TransitionMatrix::HittingTimes (int Target, double *Times) const {
+   return HittingTimes (&Target, 1, Times);
+}
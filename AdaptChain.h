@@ -0,0 +1,100 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptChain.h
+  Purpose:      Declaration for the AdaptOrg Markov chain analysis.
+*****************************************************************************/
+
+#ifndef __ADAPTCHAINH__
+#define __ADAPTCHAINH__
+
+#include "AdaptOrg.h"
+#include "AdaptPool.h"
+
+// Rows and columns per tile in the blocked matrix multiply:
+#define ADAPTCHAIN_BLOCK 64
+
+namespace AdaptOrg {
+
+   // An organism's transition probabilities for fixed sensor values, as the
+   // row-stochastic matrix P [From x StateCount + To]. Built to match
+   // UpdateState exactly: with negative weights, entries are whatever share
+   // of [0, 1] the sampler's scan actually maps to each state, and the mass
+   // it maps to no state stays on the diagonal.
+   class TransitionMatrix {
+      protected:
+         int StateCount;
+
+         double *Matrix;
+
+         // Last power computed, so repeated queries for the same step count
+         // cost a row lookup:
+         double *Cached;
+         int    CachedSteps;
+
+         ThreadPool *Pool;
+         bool       OwnPool;
+
+         bool Free ();
+         bool GetPool ();
+
+         // C = A x B, tiled and spread over the pool. C may not alias A or B:
+         bool Multiply (const double *A, const double *B, double *C);
+
+         // Dist = Initial x P^Steps a step at a time, O(Steps x StateCount^2):
+         bool Iterate (const double *Initial, int Steps, double *Dist) const;
+
+         // Gaussian elimination with partial pivoting on the N x N system
+         // A x = B, overwriting both; x ends up in B. False if singular:
+         static bool Solve (double *A, double *B, int N);
+
+      public:
+         TransitionMatrix  ();
+         TransitionMatrix  (const TransitionMatrix &T);
+         ~TransitionMatrix ();
+
+         TransitionMatrix &operator = (const TransitionMatrix &T);
+
+         // From the organism's current sensor values, or from Inputs
+         // (SensorCount floats):
+         bool Build (const Organism &Org);
+         bool Build (const Organism &Org, const float *Inputs);
+
+         int    GetStateCount  () const;
+         double GetProbability (int From, int To) const;
+
+         const double *GetData () const;
+
+         // NULL makes the matrix start its own pool when first needed:
+         bool SetThreadPool (ThreadPool *P);
+
+         // P^Steps by repeated squaring, O(StateCount^3 x log Steps). Result
+         // gets StateCount x StateCount doubles; the last power is cached:
+         bool Power (int Steps, double *Result);
+
+         // Distribution over states after Steps steps, starting in From or
+         // from the distribution Initial. Dist gets StateCount doubles:
+         bool Distribution (int From, int Steps, double *Dist);
+         bool Distribution (const double *Initial, int Steps, double *Dist);
+
+         // Draws the state Steps steps after From with one random number,
+         // or -1 on bad arguments:
+         int  FastForward (int From, int Steps, Generator &G);
+         bool FastForward (Organism &Org, int Steps);
+
+         // Long-run state occupancy. The direct solve needs a single closed
+         // class and fails otherwise; iterating the lazy chain (P + I) / 2
+         // converges either way, to the occupancy reached from Initial
+         // (uniform if NULL). Pi gets StateCount doubles:
+         bool Stationary (double *Pi) const;
+         bool Stationary (double *Pi, const double *Initial, int MaxIterations = 100000, double Tolerance = 1e-12) const;
+
+         // Expected steps until the chain first enters one of Targets, 0 for
+         // the targets themselves and INFINITY where it may never arrive.
+         // Times gets StateCount doubles:
+         bool HittingTimes (const int *Targets, int Count, double *Times) const;
+         bool HittingTimes (int Target, double *Times) const;
+   };
+}
+
+#endif
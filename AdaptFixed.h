@@ -0,0 +1,599 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptFixed.h
+  Purpose:      Declaration for the AdaptOrg fixed-shape organism.
+*****************************************************************************/
+
+#ifndef __ADAPTFIXEDH__
+#define __ADAPTFIXEDH__
+
+#include <string.h>
+#include <array>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AdaptOrg.h"
+
+namespace AdaptOrg {
+
+   // Organism whose state and sensor counts are fixed at compile time. The
+   // genome lives in inline arrays in the same layout as a contiguous
+   // Organism's, so every loop has a constant trip count and nothing is
+   // allocated once constructed. Steps like an Organism in
+   // ADAPTORG_SAMPLE_CDF mode and mutates and crosses like one, drawing the
+   // same random numbers in the same order, so a shared generator gives the
+   // same results. Converts to and from Organism and reads and writes its
+   // file format.
+   template <int States, int Sensors>
+   class FixedOrganism {
+      static_assert (States > 0 && Sensors >= 0, "FixedOrganism needs at least one state");
+
+      public:
+         static constexpr int StateCount  = States;
+         static constexpr int SensorCount = Sensors;
+         static constexpr int Stride      = 1 + Sensors;
+
+      protected:
+         // Gene (From, To) at Coeff [(From * States + To) * Stride], laid out
+         // as (base, coeff 1 .. coeff Sensors):
+         alignas (ADAPTAI_ALIGNMENT) std::array<float, States * States * Stride> Coeff;
+
+         std::array<float, Sensors> Inputs;
+
+         // Mutation factors per gene and per chromosome, i.e. per row:
+         std::array<float, States * States> GeneChance, GeneRate;
+         std::array<float, States>          CrossChance;
+         std::array<bool, States>           Crossover;
+
+         std::array<std::string, States>  StateNames;
+         std::array<std::string, Sensors> SensorNames;
+
+         int CurrentState;
+
+         // Random number source, NULL for the calling thread's generator:
+         Generator *Rng;
+
+         bool CopyGene (int Index, const FixedOrganism &From, int FromIndex) {
+            memcpy (Coeff.data () + Index * Stride, From.Coeff.data () + FromIndex * Stride, sizeof (float) * Stride);
+
+            GeneChance [Index] = From.GeneChance [FromIndex];
+            GeneRate [Index]   = From.GeneRate [FromIndex];
+
+            return true;
+         }
+
+      public:
+         FixedOrganism () {
+            Coeff.fill (0.0F);
+            Inputs.fill (0.0F);
+
+            GeneChance.fill (ADAPTAI_DEFAULTCHANCE);
+            GeneRate.fill (ADAPTAI_DEFAULTRATE);
+            CrossChance.fill (ADAPTAI_DEFAULTCHANCE);
+            Crossover.fill (true);
+
+            CurrentState = 0;
+
+            Rng = NULL;
+         }
+
+         // Organisms of another shape leave this one at its defaults:
+         explicit FixedOrganism (const Organism &Org) : FixedOrganism () {
+            Assign (Org);
+         }
+
+         bool Assign (const Organism &Org) {
+            if (Org.GetStateCount () != States || Org.GetSensorCount () != Sensors)
+               return false;
+
+            int i, j;
+
+            for (i = 0; i < States; i++) {
+               Chromosome &Chrom = Org.OrgGenome.GetChromosome (i);
+
+               Crossover [i]   = Chrom.GetCrossoverState ();
+               CrossChance [i] = Chrom.GetCrossoverMutationChance ();
+
+               for (j = 0; j < States; j++) {
+                  Gene &G = Chrom.GetGene (j);
+
+                  for (int k = 0; k < Stride; k++)
+                     Coeff [(i * States + j) * Stride + k] = G.GetElement (k);
+
+                  GeneChance [i * States + j] = G.GetMutationChance ();
+                  GeneRate [i * States + j]   = G.GetMutationRate ();
+               }
+
+               StateNames [i] = Org.States [i].Name;
+            }
+
+            for (i = 0; i < Sensors; i++) {
+               SensorNames [i] = Org.Sensors [i].Name;
+               Inputs [i]      = Org.GetSensorValue (i);
+            }
+
+            CurrentState = Org.GetCurrentState ();
+
+            return true;
+         }
+
+         bool Store (Organism &Org) const {
+            if (!Org.SetSensorCount (Sensors) || !Org.SetStateCount (States))
+               return false;
+
+            int i, j;
+
+            for (i = 0; i < States; i++)
+               Org.SetStateName (i, StateNames [i]);
+
+            for (i = 0; i < Sensors; i++)
+               Org.SetSensorName (i, SensorNames [i]);
+
+            if (Org.GetBoundSensors () == NULL) {
+               for (i = 0; i < Sensors; i++)
+                  Org.SetSensorValue (i, Inputs [i]);
+            }
+
+            // The genome goes over in its bulk buffer format, which keeps the
+            // mutation factors exactly as they are:
+            std::vector<char> Buffer (ADAPTAI_BULK_HEADER + 3 * sizeof (int) * (States + States * States) + sizeof (Coeff));
+
+            int       Version = ADAPTAI_BULK_VERSION, Count = States, GeneTotal = States * States;
+            long long Bytes   = Buffer.size ();
+
+            char *Out = Buffer.data ();
+
+            memcpy (Out,      ADAPTAI_BULK_MAGIC, 4);
+            memcpy (Out + 4,  &Version,           sizeof (int));
+            memcpy (Out + 8,  &Count,             sizeof (int));
+            memcpy (Out + 12, &GeneTotal,         sizeof (int));
+            memcpy (Out + 16, &Bytes,             sizeof (long long));
+
+            char *Chroms = Out + ADAPTAI_BULK_HEADER;
+            char *Genes  = Chroms + 3 * sizeof (int) * States;
+
+            for (i = 0; i < States; i++) {
+               int Cross = Crossover [i] ? 1 : 0;
+
+               memcpy (Chroms,     &Count,           sizeof (int));
+               memcpy (Chroms + 4, &Cross,           sizeof (int));
+               memcpy (Chroms + 8, &CrossChance [i], sizeof (float));
+
+               Chroms += 3 * sizeof (int);
+
+               for (j = 0; j < States; j++) {
+                  int Length = Stride;
+
+                  memcpy (Genes,     &Length,                      sizeof (int));
+                  memcpy (Genes + 4, &GeneChance [i * States + j], sizeof (float));
+                  memcpy (Genes + 8, &GeneRate [i * States + j],   sizeof (float));
+
+                  Genes += 3 * sizeof (int);
+               }
+            }
+
+            memcpy (Genes, Coeff.data (), sizeof (Coeff));
+
+            if (Org.OrgGenome.LoadBuffer (Buffer.data (), Buffer.size ()) == 0)
+               return false;
+
+            Org.SetCurrentState (CurrentState);
+
+            return Org.Invalidate ();
+         }
+
+         static constexpr int GetStateCount  () { return States; }
+         static constexpr int GetSensorCount () { return Sensors; }
+
+         std::string GetStateName (int Index) const {
+            return (Index >= 0 && Index < States) ? StateNames [Index] : std::string ();
+         }
+
+         bool SetStateName (int Index, std::string Name) {
+            if (Index < 0 || Index >= States)
+               return false;
+
+            StateNames [Index] = Name;
+
+            return true;
+         }
+
+         // Lowest index with the name, or -1. A plain scan, the arrays are small:
+         int GetStateIndex (std::string_view Name) const {
+            for (int i = 0; i < States; i++) {
+               if (StateNames [i] == Name)
+                  return i;
+            }
+
+            return -1;
+         }
+
+         std::string GetSensorName (int Index) const {
+            return (Index >= 0 && Index < Sensors) ? SensorNames [Index] : std::string ();
+         }
+
+         bool SetSensorName (int Index, std::string Name) {
+            if (Index < 0 || Index >= Sensors)
+               return false;
+
+            SensorNames [Index] = Name;
+
+            return true;
+         }
+
+         int GetSensorIndex (std::string_view Name) const {
+            for (int i = 0; i < Sensors; i++) {
+               if (SensorNames [i] == Name)
+                  return i;
+            }
+
+            return -1;
+         }
+
+         float GetSensorValue (int Index) const {
+            return (Index >= 0 && Index < Sensors) ? Inputs [Index] : 0.0F;
+         }
+
+         float GetSensorValue (std::string_view Name) const {
+            return GetSensorValue (GetSensorIndex (Name));
+         }
+
+         bool SetSensorValue (int Index, float Value) {
+            if (Index < 0 || Index >= Sensors)
+               return false;
+
+            Inputs [Index] = Value;
+
+            return true;
+         }
+
+         bool SetSensorValue (std::string_view Name, float Value) {
+            return SetSensorValue (GetSensorIndex (Name), Value);
+         }
+
+         bool SetTransition (int Index1, int Index2, float BaseChance, const float *SensorCoeff) {
+            if (Index1 < 0 || Index1 >= States || Index2 < 0 || Index2 >= States)
+               return false;
+
+            float *G = Coeff.data () + (Index1 * States + Index2) * Stride;
+
+            G [0] = BaseChance;
+
+            for (int i = 0; i < Sensors; i++)
+               G [1 + i] = SensorCoeff [i];
+
+            return true;
+         }
+
+         int GetCurrentState () const {
+            return CurrentState;
+         }
+
+         bool SetCurrentState (int Index) {
+            if (Index < 0 || Index >= States)
+               return false;
+
+            CurrentState = Index;
+
+            return true;
+         }
+
+         bool SetGenerator (Generator *G) {
+            Rng = G;
+
+            return true;
+         }
+
+         Generator &GetGenerator () const {
+            if (Rng != NULL)
+               return *Rng;
+
+            return AdaptAI::GetGenerator ();
+         }
+
+         float       *GetData ()       { return Coeff.data (); }
+         const float *GetData () const { return Coeff.data (); }
+
+         bool UpdateState () {
+            const float *Row = Coeff.data () + CurrentState * States * Stride;
+
+            float Cdf [States];
+
+            int i, j;
+
+            for (i = 0; i < States; i++) {
+               float W = Row [i * Stride];
+
+               for (j = 0; j < Sensors; j++)
+                  W += Row [i * Stride + 1 + j] * Inputs [j];
+
+               Cdf [i] = W;
+            }
+
+            // Same sums, checks and comparisons as CumulateRow and SampleCdf:
+            bool  Monotone = true;
+            float Total    = 0.0F;
+
+            for (i = 0; i < States; i++) {
+               if (!(Cdf [i] >= 0.0F))
+                  Monotone = false;
+
+               Total += Cdf [i];
+
+               Cdf [i] = Total;
+            }
+
+            Monotone = Monotone && Total > 0.0F;
+
+            float Choice = GetGenerator ().Random ();
+
+            int Next = -1;
+
+            if (Monotone) {
+               float Target = Choice * Total;
+
+               if (Target <= Total) {
+                  // The entries below Target are a prefix, so counting them
+                  // finds the first one that reaches it without branching:
+                  int Below = 0;
+
+                  for (i = 0; i < States; i++)
+                     Below += (Cdf [i] < Target);
+
+                  Next = (Below < States) ? Below : States - 1;
+               }
+            }
+            else {
+               for (i = 0; i < States; i++) {
+                  if (Choice <= Cdf [i] / Total) {
+                     Next = i;
+
+                     break;
+                  }
+               }
+            }
+
+            if (Next >= 0)
+               CurrentState = Next;
+
+            return true;
+         }
+
+         bool Mutate () {
+            return Mutate (GetGenerator ());
+         }
+
+         bool Mutate (Generator &G) {
+            // One cursor spans the whole genome, as in Genome::Mutate:
+            MutationCursor Cursor;
+
+            for (int i = 0; i < States; i++) {
+               if (G.Random () <= CrossChance [i])
+                  Crossover [i] = !Crossover [i];
+
+               for (int j = 0; j < States; j++) {
+                  float *Seq = Coeff.data () + (i * States + j) * Stride;
+
+                  if (Cursor.Chance != GeneChance [i * States + j])
+                     Cursor.Reset (GeneChance [i * States + j], G);
+
+                  long long k = Cursor.Gap;
+
+                  while (k < Stride) {
+                     Seq [k] = Seq [k] + (2.0F * G.Random () - 1.0F) * GeneRate [i * States + j];
+
+                     k += 1 + Cursor.Draw (G);
+                  }
+
+                  Cursor.Gap = k - Stride;
+               }
+            }
+
+            return true;
+         }
+
+         bool MutateMutationFactors (float Chance, float Rate) {
+            return MutateMutationFactors (Chance, Rate, GetGenerator ());
+         }
+
+         bool MutateMutationFactors (float Chance, float Rate, Generator &G) {
+            for (int i = 0; i < States; i++) {
+               if (G.Random () <= Chance) {
+                  float C = CrossChance [i] + (G.Random () * 2.0F - 1.0F) * Rate;
+
+                  // Clamped like Chromosome::SetCrossoverMutationChance:
+                  CrossChance [i] = (C < 0.0F) ? 0.0F : ((C > 1.0F) ? 1.0F : C);
+               }
+
+               for (int j = 0; j < States; j++) {
+                  if (G.Random () <= Chance) {
+                     GeneChance [i * States + j] += (G.Random () * 2.0F - 1.0F) * Rate;
+                     GeneRate [i * States + j]   += (G.Random () * 2.0F - 1.0F) * Rate;
+                  }
+               }
+            }
+
+            return true;
+         }
+
+         // Organism::Cross without the allocations. Child may be either parent:
+         bool Cross (const FixedOrganism &Mate, FixedOrganism &Child, Generator &G) const {
+            // The child takes this parent's names and sensor values:
+            if (&Child != this) {
+               Child.Inputs      = Inputs;
+               Child.StateNames  = StateNames;
+               Child.SensorNames = SensorNames;
+            }
+
+            for (int i = 0; i < States; i++) {
+               bool  Cross1  = Crossover [i],   Cross2  = Mate.Crossover [i];
+               float Chance1 = CrossChance [i], Chance2 = Mate.CrossChance [i];
+
+               if (Cross1) {
+                  if (G.Random () < 0.5F) {
+                     Child.Crossover [i]   = Cross1;
+                     Child.CrossChance [i] = Chance1;
+                  }
+                  else {
+                     Child.Crossover [i]   = Cross2;
+                     Child.CrossChance [i] = Chance2;
+                  }
+
+                  for (int j = i * States; j < (i + 1) * States; j++) {
+                     if (G.Random () < 0.5F)
+                        Child.CopyGene (j, *this, j);
+                     else Child.CopyGene (j, Mate, j);
+                  }
+               }
+               else {
+                  if (G.Random () < 0.5F)
+                     Child.Crossover [i] = Cross1;
+                  else Child.Crossover [i] = Cross2;
+
+                  Child.CrossChance [i] = (Chance1 + Chance2) / 2.0F;
+
+                  for (int j = i * States; j < (i + 1) * States; j++) {
+                     for (int k = j * Stride; k < (j + 1) * Stride; k++)
+                        Child.Coeff [k] = (Coeff [k] + Mate.Coeff [k]) / 2.0F;
+
+                     Child.GeneChance [j] = ADAPTAI_DEFAULTCHANCE;
+                     Child.GeneRate [j]   = ADAPTAI_DEFAULTRATE;
+                  }
+               }
+            }
+
+            Child.CurrentState = 0;
+
+            return Child.Mutate (G);
+         }
+
+         bool Save (std::fstream &File) const {
+            // Organism::Save's format, written field by field:
+            int Count = States;
+
+            File.write ((const char *) &Count,        sizeof (int));
+            Count = Sensors;
+            File.write ((const char *) &Count,        sizeof (int));
+            File.write ((const char *) &CurrentState, sizeof (int));
+
+            int i, j;
+
+            for (i = 0; i < States; i++) {
+               Count = StateNames [i].size () + 1;
+
+               File.write ((const char *) &Count, sizeof (int));
+               File.write (StateNames [i].c_str (), Count);
+            }
+
+            for (i = 0; i < Sensors; i++) {
+               Count = SensorNames [i].size () + 1;
+
+               File.write ((const char *) &Count,      sizeof (int));
+               File.write ((const char *) &Inputs [i], sizeof (float));
+               File.write (SensorNames [i].c_str (), Count);
+            }
+
+            Count = States;
+
+            File.write ((const char *) &Count, sizeof (int));
+
+            for (i = 0; i < States; i++) {
+               bool Cross = Crossover [i];
+
+               File.write ((const char *) &Count,           sizeof (int));
+               File.write ((const char *) &Cross,           sizeof (bool));
+               File.write ((const char *) &CrossChance [i], sizeof (float));
+
+               for (j = i * States; j < (i + 1) * States; j++) {
+                  int Length = Stride;
+
+                  File.write ((const char *) &Length,         sizeof (int));
+                  File.write ((const char *) &GeneChance [j], sizeof (float));
+                  File.write ((const char *) &GeneRate [j],   sizeof (float));
+                  File.write ((const char *) (Coeff.data () + j * Stride), sizeof (float) * Stride);
+               }
+            }
+
+            return File.good ();
+         }
+
+         // Fails, leaving this organism partly read, if the file holds an
+         // organism of another shape:
+         bool Load (std::fstream &File) {
+            int Count = 0, Sense = 0, Current = 0;
+
+            File.read ((char *) &Count,   sizeof (int));
+            File.read ((char *) &Sense,   sizeof (int));
+            File.read ((char *) &Current, sizeof (int));
+
+            if (!File.good () || Count != States || Sense != Sensors || Current < 0 || Current >= States)
+               return false;
+
+            CurrentState = Current;
+
+            int i, j;
+
+            std::vector<char> Name;
+
+            for (i = 0; i < States + Sensors; i++) {
+               File.read ((char *) &Count, sizeof (int));
+
+               if (!File.good () || Count <= 0)
+                  return false;
+
+               if (i >= States)
+                  File.read ((char *) &Inputs [i - States], sizeof (float));
+
+               Name.resize (Count);
+
+               File.read (Name.data (), Count);
+
+               if (!File.good ())
+                  return false;
+
+               // Names end at the first terminator, as in State::Load:
+               std::string &Target = (i < States) ? StateNames [i] : SensorNames [i - States];
+
+               Target.assign (Name.data (), strnlen (Name.data (), Count));
+            }
+
+            File.read ((char *) &Count, sizeof (int));
+
+            if (!File.good () || Count != States)
+               return false;
+
+            for (i = 0; i < States; i++) {
+               bool Cross;
+
+               File.read ((char *) &Count,           sizeof (int));
+               File.read ((char *) &Cross,           sizeof (bool));
+               File.read ((char *) &CrossChance [i], sizeof (float));
+
+               if (!File.good () || Count != States)
+                  return false;
+
+               Crossover [i] = Cross;
+
+               for (j = i * States; j < (i + 1) * States; j++) {
+                  int Length = 0;
+
+                  File.read ((char *) &Length,         sizeof (int));
+                  File.read ((char *) &GeneChance [j], sizeof (float));
+                  File.read ((char *) &GeneRate [j],   sizeof (float));
+
+                  if (!File.good () || Length != Stride)
+                     return false;
+
+                  File.read ((char *) (Coeff.data () + j * Stride), sizeof (float) * Stride);
+               }
+            }
+
+            return File.good ();
+         }
+   };
+}
+
+#endif
@@ -0,0 +1,520 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptKern.cpp
+  Purpose:      Implementation for the AdaptAI numeric kernels.
+*****************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include <atomic>
+
+#include "AdaptKern.h"
+
+#if (defined (__GNUC__) || defined (__clang__)) && (defined (__x86_64__) || defined (__i386__))
+#define ADAPTKERN_X86
+#include <immintrin.h>
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+using namespace AdaptAI;
+
+typedef void (*RowKernel) (const float *Row, int Count, int Stride,
+                           const float *Inputs, int InputCount, float *Weights);
+
+//
+// Row evaluation kernels
+//
+
+static void EvaluateRowScalar (const float *Row, int Count, int Stride,
+                               const float *Inputs, int InputCount, float *Weights) {
+   for (int i = 0; i < Count; i++) {
+      const float *G = Row + i * Stride;
+
+      float W = G [0];
+
+      for (int j = 0; j < InputCount; j++)
+         W += G [1 + j] * Inputs [j];
+
+      Weights [i] = W;
+   }
+}
+
+#ifdef ADAPTKERN_X86
+
+__attribute__ ((target ("sse2")))
+static void EvaluateRowSSE (const float *Row, int Count, int Stride,
+                            const float *Inputs, int InputCount, float *Weights) {
+   for (int i = 0; i < Count; i++) {
+      const float *G = Row + i * Stride + 1;
+
+      __m128 Acc = _mm_setzero_ps ();
+
+      int j = 0;
+
+      for (; j + 4 <= InputCount; j += 4)
+         Acc = _mm_add_ps (Acc, _mm_mul_ps (_mm_loadu_ps (G + j), _mm_loadu_ps (Inputs + j)));
+
+      // Horizontal sum:
+      __m128 Shuf = _mm_shuffle_ps (Acc, Acc, _MM_SHUFFLE (2, 3, 0, 1));
+
+      Acc  = _mm_add_ps (Acc, Shuf);
+      Shuf = _mm_movehl_ps (Shuf, Acc);
+      Acc  = _mm_add_ss (Acc, Shuf);
+
+      float W = G [-1] + _mm_cvtss_f32 (Acc);
+
+      for (; j < InputCount; j++)
+         W += G [j] * Inputs [j];
+
+      Weights [i] = W;
+   }
+}
+
+__attribute__ ((target ("avx2,fma")))
+static void EvaluateRowAVX2 (const float *Row, int Count, int Stride,
+                             const float *Inputs, int InputCount, float *Weights) {
+   int i = 0;
+
+   if (InputCount < 8) {
+      // Too few sensors to fill a register, so work across eight target
+      // states at once with strided gathers instead:
+      const __m256i Index = _mm256_mullo_epi32 (_mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7),
+                                                _mm256_set1_epi32 (Stride));
+
+      for (; i + 8 <= Count; i += 8) {
+         const float *G = Row + i * Stride;
+
+         __m256 Acc = _mm256_i32gather_ps (G, Index, 4);
+
+         for (int j = 0; j < InputCount; j++)
+            Acc = _mm256_fmadd_ps (_mm256_i32gather_ps (G + 1 + j, Index, 4), _mm256_set1_ps (Inputs [j]), Acc);
+
+         _mm256_storeu_ps (Weights + i, Acc);
+      }
+
+      EvaluateRowScalar (Row + i * Stride, Count - i, Stride, Inputs, InputCount, Weights + i);
+
+      return;
+   }
+
+   for (; i < Count; i++) {
+      const float *G = Row + i * Stride + 1;
+
+      __m256 Acc = _mm256_setzero_ps ();
+
+      int j = 0;
+
+      for (; j + 8 <= InputCount; j += 8)
+         Acc = _mm256_fmadd_ps (_mm256_loadu_ps (G + j), _mm256_loadu_ps (Inputs + j), Acc);
+
+      // Horizontal sum:
+      __m128 Sum = _mm_add_ps (_mm256_castps256_ps128 (Acc), _mm256_extractf128_ps (Acc, 1));
+
+      Sum = _mm_hadd_ps (Sum, Sum);
+      Sum = _mm_hadd_ps (Sum, Sum);
+
+      float W = G [-1] + _mm_cvtss_f32 (Sum);
+
+      for (; j < InputCount; j++)
+         W += G [j] * Inputs [j];
+
+      Weights [i] = W;
+   }
+}
+
+#endif
+
+//
+// Dispatch
+//
+
+// Resolved on first use, threads may race to store the same choice:
+static std::atomic<RowKernel> RowFunction (NULL);
+static std::atomic<int>       RowKernelId (ADAPTAI_KERNEL_AUTO);
+
+static bool KernelSupported (int Kernel) {
+   switch (Kernel) {
+      case ADAPTAI_KERNEL_SCALAR:
+         return true;
+
+#ifdef ADAPTKERN_X86
+      case ADAPTAI_KERNEL_SSE:
+         __builtin_cpu_init ();
+         return __builtin_cpu_supports ("sse2");
+
+      case ADAPTAI_KERNEL_AVX2:
+         __builtin_cpu_init ();
+         return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+#endif
+   }
+
+   return false;
+}
+
+bool AdaptAI::SetKernel (int Kernel) {
+   if (Kernel == ADAPTAI_KERNEL_AUTO) {
+      Kernel = ADAPTAI_KERNEL_SCALAR;
+
+      if (KernelSupported (ADAPTAI_KERNEL_SSE))
+         Kernel = ADAPTAI_KERNEL_SSE;
+
+      if (KernelSupported (ADAPTAI_KERNEL_AVX2))
+         Kernel = ADAPTAI_KERNEL_AVX2;
+   }
+
+   if (!KernelSupported (Kernel))
+      return false;
+
+   RowKernel Function = EvaluateRowScalar;
+
+   switch (Kernel) {
+#ifdef ADAPTKERN_X86
+      case ADAPTAI_KERNEL_SSE:
+         Function = EvaluateRowSSE;
+         break;
+
+      case ADAPTAI_KERNEL_AVX2:
+         Function = EvaluateRowAVX2;
+         break;
+#endif
+   }
+
+   RowKernelId.store (Kernel, std::memory_order_relaxed);
+   RowFunction.store (Function, std::memory_order_relaxed);
+
+   return true;
+}
+
+int AdaptAI::GetKernel () {
+   if (RowFunction.load (std::memory_order_relaxed) == NULL)
+      SetKernel (ADAPTAI_KERNEL_AUTO);
+
+   return RowKernelId.load (std::memory_order_relaxed);
+}
+
+void AdaptAI::EvaluateRow (const float *Row, int Count, int Stride,
+                           const float *Inputs, int InputCount, float *Weights) {
+   RowKernel Function = RowFunction.load (std::memory_order_relaxed);
+
+   if (Function == NULL) {
+      SetKernel (ADAPTAI_KERNEL_AUTO);
+
+      Function = RowFunction.load (std::memory_order_relaxed);
+   }
+
+   Function (Row, Count, Stride, Inputs, InputCount, Weights);
+}
+
+//
+// Sampling
+//
+
+bool AdaptAI::CumulateRow (float *Weights, int Count) {
+   bool Monotone = true;
+
+   float Sum = 0.0F;
+
+   for (int i = 0; i < Count; i++) {
+      if (!(Weights [i] >= 0.0F))
+         Monotone = false;
+
+      Sum += Weights [i];
+
+      Weights [i] = Sum;
+   }
+
+   return Monotone && Sum > 0.0F;
+}
+
+int AdaptAI::SampleCdf (const float *Cdf, int Count, bool Monotone, float Choice) {
+   if (Count <= 0)
+      return -1;
+
+   float Total = Cdf [Count - 1];
+
+   if (!Monotone) {
+      // Negative weights, the normalized CDF may go up and down so scan it:
+      for (int i = 0; i < Count; i++) {
+         if (Choice <= Cdf [i] / Total)
+            return i;
+      }
+
+      return -1;
+   }
+
+   float Target = Choice * Total;
+
+   if (!(Target <= Total))
+      return -1;
+
+   // Binary search for the first entry >= Target:
+   int Low = 0, High = Count - 1;
+
+   while (Low < High) {
+      int Mid = (Low + High) / 2;
+
+      if (Cdf [Mid] < Target)
+         Low = Mid + 1;
+      else High = Mid;
+   }
+
+   return Low;
+}
+
+bool AdaptAI::BuildAlias (const float *Weights, int Count, float *Prob, int *Alias, int *Work) {
+   if (Count <= 0)
+      return false;
+
+   int i;
+
+   double Total = 0.0;
+
+   for (i = 0; i < Count; i++) {
+      if (!(Weights [i] >= 0.0F))
+         return false;
+
+      Total += Weights [i];
+   }
+
+   if (!(Total > 0.0))
+      return false;
+
+   // Small entries stack up from the front of Work, large ones from the back:
+   int Small = 0, Large = Count;
+
+   double Scale = Count / Total;
+
+   for (i = 0; i < Count; i++) {
+      Prob  [i] = (float) (Weights [i] * Scale);
+      Alias [i] = i;
+
+      if (Prob [i] < 1.0F)
+         Work [Small++] = i;
+      else Work [--Large] = i;
+   }
+
+   while (Small > 0 && Large < Count) {
+      int s = Work [--Small];
+      int l = Work [Large++];
+
+      Alias [s] = l;
+
+      Prob [l] = (Prob [l] + Prob [s]) - 1.0F;
+
+      if (Prob [l] < 1.0F)
+         Work [Small++] = l;
+      else Work [--Large] = l;
+   }
+
+   // Whatever is left is full up to rounding:
+   while (Large < Count)
+      Prob [Work [Large++]] = 1.0F;
+
+   while (Small > 0)
+      Prob [Work [--Small]] = 1.0F;
+
+   return true;
+}
+
+int AdaptAI::SampleAlias (const float *Prob, const int *Alias, int Count, float Choice, float Coin) {
+   int i = (int) (Choice * Count);
+
+   if (i >= Count)
+      i = Count - 1;
+
+   return (Coin < Prob [i]) ? i : Alias [i];
+}
+
+//
+// Reduced precision
+//
+
+#ifdef ADAPTKERN_X86
+
+// F16C conversions, used alongside the AVX2 row kernel:
+static bool HalfSupported () {
+   static const bool Supported = (__builtin_cpu_init (), __builtin_cpu_supports ("f16c"));
+
+   return Supported && GetKernel () == ADAPTAI_KERNEL_AVX2;
+}
+
+__attribute__ ((target ("avx,f16c")))
+static int FloatToHalfF16C (const float *In, int Count, unsigned short *Out) {
+   int i = 0;
+
+   for (; i + 8 <= Count; i += 8)
+      _mm_storeu_si128 ((__m128i *) (Out + i), _mm256_cvtps_ph (_mm256_loadu_ps (In + i), _MM_FROUND_TO_NEAREST_INT));
+
+   return i;
+}
+
+__attribute__ ((target ("avx,f16c")))
+static int HalfToFloatF16C (const unsigned short *In, int Count, float *Out) {
+   int i = 0;
+
+   for (; i + 8 <= Count; i += 8)
+      _mm256_storeu_ps (Out + i, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i *) (In + i))));
+
+   return i;
+}
+
+#endif
+
+void AdaptAI::FloatToHalf (const float *In, int Count, unsigned short *Out) {
+   int i = 0;
+
+#ifdef ADAPTKERN_X86
+   // Whole groups of eight in hardware, the tail below:
+   if (HalfSupported ())
+      i = FloatToHalfF16C (In, Count, Out);
+#endif
+
+   for (; i < Count; i++) {
+      unsigned int x;
+
+      memcpy (&x, In + i, sizeof (float));
+
+      unsigned int Sign     = (x >> 16) & 0x8000;
+      unsigned int Mantissa = x & 0x7FFFFF;
+      int          Exponent = (int) ((x >> 23) & 0xFF) - 127 + 15;
+
+      unsigned int h;
+
+      // Inf, or NaN quieted with its top payload bits like F16C does:
+      if (((x >> 23) & 0xFF) == 0xFF)
+         h = 0x7C00 | (Mantissa ? 0x200 | (Mantissa >> 13) : 0);
+      else if (Exponent >= 31)
+         h = 0x7C00;                            // Overflow to Inf
+      else if (Exponent <= 0) {
+         // Subnormal, or zero below half the smallest one:
+         if (Exponent < -10)
+            h = 0;
+         else {
+            Mantissa |= 0x800000;
+
+            int Shift = 14 - Exponent;
+
+            unsigned int Rest = Mantissa & ((1U << Shift) - 1), Half = 1U << (Shift - 1);
+
+            h = Mantissa >> Shift;
+
+            if (Rest > Half || (Rest == Half && (h & 1)))
+               h++;
+         }
+      }
+      else {
+         unsigned int Rest = Mantissa & 0x1FFF;
+
+         h = ((unsigned int) Exponent << 10) | (Mantissa >> 13);
+
+         // A carry out of the mantissa correctly bumps the exponent:
+         if (Rest > 0x1000 || (Rest == 0x1000 && (h & 1)))
+            h++;
+      }
+
+      Out [i] = (unsigned short) (Sign | h);
+   }
+}
+
+void AdaptAI::HalfToFloat (const unsigned short *In, int Count, float *Out) {
+   int i = 0;
+
+#ifdef ADAPTKERN_X86
+   if (HalfSupported ())
+      i = HalfToFloatF16C (In, Count, Out);
+#endif
+
+   for (; i < Count; i++) {
+      unsigned int Sign     = (unsigned int) (In [i] & 0x8000) << 16;
+      unsigned int Exponent = (In [i] >> 10) & 0x1F;
+      unsigned int Mantissa = In [i] & 0x3FF;
+
+      unsigned int x;
+
+      if (Exponent == 0x1F)
+         x = Sign | 0x7F800000 | (Mantissa ? 0x400000 | (Mantissa << 13) : 0);
+      else if (Exponent != 0)
+         x = Sign | ((Exponent + 112) << 23) | (Mantissa << 13);
+      else if (Mantissa == 0)
+         x = Sign;
+      else {
+         // Subnormal, normalize it:
+         unsigned int e = 113;
+
+         while (!(Mantissa & 0x400)) {
+            Mantissa <<= 1;
+            e--;
+         }
+
+         x = Sign | (e << 23) | ((Mantissa & 0x3FF) << 13);
+      }
+
+      memcpy (Out + i, &x, sizeof (float));
+   }
+}
+
+void AdaptAI::FloatToBFloat (const float *In, int Count, unsigned short *Out) {
+   for (int i = 0; i < Count; i++) {
+      unsigned int x;
+
+      memcpy (&x, In + i, sizeof (float));
+
+      // Keep NaNs quiet rather than letting rounding turn them into Inf:
+      if ((x & 0x7FFFFFFF) > 0x7F800000)
+         Out [i] = (unsigned short) ((x >> 16) | 0x40);
+      else Out [i] = (unsigned short) ((x + 0x7FFF + ((x >> 16) & 1)) >> 16);
+   }
+}
+
+void AdaptAI::BFloatToFloat (const unsigned short *In, int Count, float *Out) {
+   for (int i = 0; i < Count; i++) {
+      unsigned int x = (unsigned int) In [i] << 16;
+
+      memcpy (Out + i, &x, sizeof (float));
+   }
+}
+
+float AdaptAI::QuantizeRow (const float *In, int Count, signed char *Out) {
+   float Max = 0.0F;
+
+   int i;
+
+   for (i = 0; i < Count; i++) {
+      if (fabsf (In [i]) > Max)
+         Max = fabsf (In [i]);
+   }
+
+   if (!(Max > 0.0F) || !isfinite (Max)) {
+      memset (Out, 0, Count);
+
+      return 0.0F;
+   }
+
+   float Scale = Max / 127.0F, Inverse = 127.0F / Max;
+
+   for (i = 0; i < Count; i++) {
+      float q = nearbyintf (In [i] * Inverse);
+
+      int Code = 0;
+
+      if (q > 127.0F)
+         Code = 127;
+      else if (q < -127.0F)
+         Code = -127;
+      else if (q == q)
+         Code = (int) q;
+
+      Out [i] = (signed char) Code;
+   }
+
+   return Scale;
+}
+
+void AdaptAI::DequantizeRow (const signed char *In, int Count, float Scale, float *Out) {
+   for (int i = 0; i < Count; i++)
+      Out [i] = In [i] * Scale;
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptKern.h
+  Purpose:      Declaration for the AdaptAI numeric kernels.
+*****************************************************************************/
+
+#ifndef __ADAPTKERNH__
+#define __ADAPTKERNH__
+
+#define ADAPTAI_KERNEL_AUTO   0
+#define ADAPTAI_KERNEL_SCALAR 1
+#define ADAPTAI_KERNEL_SSE    2
+#define ADAPTAI_KERNEL_AVX2   3
+
+namespace AdaptAI {
+   // Unnormalized transition weights for one row of Count genes, each Stride
+   // floats apart and laid out as (base, coeff 1 .. coeff InputCount):
+   //
+   //    Weights [i] = Row [i * Stride] + sum (Row [i * Stride + 1 + j] * Inputs [j])
+   extern void EvaluateRow (const float *Row, int Count, int Stride,
+                            const float *Inputs, int InputCount, float *Weights);
+
+   // Turns Weights into its running sum in O(Count). Returns true when every
+   // weight was non-negative and the total positive, i.e. the result is a
+   // monotone CDF that SampleCdf may binary search:
+   extern bool CumulateRow (float *Weights, int Count);
+
+   // First index whose normalized cumulative weight reaches Choice, or -1:
+   extern int SampleCdf (const float *Cdf, int Count, bool Monotone, float Choice);
+
+   // Walker/Vose alias table for non-negative weights with a positive total.
+   // Work needs room for Count ints. Returns false if the weights don't qualify:
+   extern bool BuildAlias (const float *Weights, int Count, float *Prob, int *Alias, int *Work);
+
+   // O(1) draw from an alias table given two uniform numbers in [0, 1]:
+   extern int SampleAlias (const float *Prob, const int *Alias, int Count, float Choice, float Coin);
+
+   // IEEE half precision and bfloat16, rounded to nearest even:
+   extern void FloatToHalf  (const float *In, int Count, unsigned short *Out);
+   extern void HalfToFloat  (const unsigned short *In, int Count, float *Out);
+   extern void FloatToBFloat (const float *In, int Count, unsigned short *Out);
+   extern void BFloatToFloat (const unsigned short *In, int Count, float *Out);
+
+   // Symmetric 8-bit codes, In [i] ~ Out [i] * Scale with Scale = max |In| / 127.
+   // Returns Scale, 0 for an all-zero row:
+   extern float QuantizeRow   (const float *In, int Count, signed char *Out);
+   extern void  DequantizeRow (const signed char *In, int Count, float Scale, float *Out);
+
+   // Kernel selection, ADAPTAI_KERNEL_AUTO picks the best one the CPU supports:
+   extern bool SetKernel (int Kernel);
+   extern int  GetKernel ();
+}
+
+#endif
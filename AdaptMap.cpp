@@ -0,0 +1,484 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptMap.cpp
+  Purpose:      Implementation for the AdaptOrg memory-mapped organism image.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "AdaptMap.h"
+#include "AdaptKern.h"
+
+using namespace AdaptOrg;
+
+static int64_t AlignOffset (int64_t Offset, int64_t Alignment) {
+   return (Offset + Alignment - 1) / Alignment * Alignment;
+}
+
+MappedOrganism::MappedOrganism () {
+   Image     = NULL;
+   ImageSize = 0;
+
+   Header = NULL;
+   Coeff  = NULL;
+
+   StateCount = SensorCount = CurrentState = 0;
+
+   StateNames = SensorNames = NULL;
+
+   Values = NULL;
+
+   Rng = NULL;
+}
+
+MappedOrganism::~MappedOrganism () {
+   Close ();
+}
+
+bool MappedOrganism::Write (const Organism &Org, std::string FileName) {
+   int i, j, k;
+
+   int S      = Org.StateCount;
+   int K      = Org.SensorCount;
+   int Length = 1 + K;
+
+   ImageHeader H;
+
+   memset (&H, 0, sizeof (ImageHeader));
+   memcpy (H.Magic, ADAPTMAP_MAGIC, sizeof (H.Magic));
+
+   H.Version      = ADAPTMAP_VERSION;
+   H.HeaderSize   = sizeof (ImageHeader);
+   H.StateCount   = S;
+   H.SensorCount  = K;
+   H.CurrentState = Org.CurrentState;
+
+   // Lay the sections out, each aligned for its contents:
+   int64_t Offset = sizeof (ImageHeader);
+
+   H.NameOffset = Offset;
+
+   for (i = 0; i < S; i++)
+      Offset += sizeof (int32_t) + Org.States [i].Name.size ();
+
+   for (i = 0; i < K; i++)
+      Offset += sizeof (int32_t) + Org.Sensors [i].Name.size ();
+
+   H.ValueOffset  = AlignOffset (Offset, sizeof (float));
+   H.FactorOffset = H.ValueOffset + (int64_t) sizeof (float) * K;
+   H.CoeffOffset  = AlignOffset (H.FactorOffset + (int64_t) (2 * sizeof (float)) * (S + (int64_t) S * S), ADAPTAI_ALIGNMENT);
+   H.FileSize     = H.CoeffOffset + (int64_t) sizeof (float) * S * S * Length;
+
+   char *Buffer = new char [H.FileSize];
+
+   memset (Buffer, 0, H.FileSize);
+   memcpy (Buffer, &H, sizeof (ImageHeader));
+
+   // Names:
+   char *Out = Buffer + H.NameOffset;
+
+   for (i = 0; i < S + K; i++) {
+      const std::string &Name = (i < S) ? Org.States [i].Name : Org.Sensors [i - S].Name;
+
+      int32_t Count = Name.size ();
+
+      memcpy (Out, &Count, sizeof (int32_t));
+      memcpy (Out + sizeof (int32_t), Name.data (), Count);
+
+      Out += sizeof (int32_t) + Count;
+   }
+
+   // Sensor values:
+   float *Values = (float *) (Buffer + H.ValueOffset);
+
+   for (i = 0; i < K; i++)
+      Values [i] = Org.Sensors [i].Value;
+
+   // Mutation factors:
+   float *Factors = (float *) (Buffer + H.FactorOffset);
+
+   for (i = 0; i < S; i++) {
+      Chromosome &Chrom = Org.OrgGenome.GetChromosome (i);
+
+      int32_t Crossover = Chrom.GetCrossoverState () ? 1 : 0;
+
+      memcpy (Factors + 2 * i, &Crossover, sizeof (int32_t));
+
+      Factors [2 * i + 1] = Chrom.GetCrossoverMutationChance ();
+
+      for (j = 0; j < S; j++) {
+         Gene &G = Chrom.GetGene (j);
+
+         Factors [2 * S + 2 * (i * S + j)]     = G.GetMutationChance ();
+         Factors [2 * S + 2 * (i * S + j) + 1] = G.GetMutationRate ();
+      }
+   }
+
+   // Coefficients, straight from the block when the genome has one:
+   float *Block = (float *) (Buffer + H.CoeffOffset);
+
+   const float *Data = Org.OrgGenome.GetData ();
+
+   if (Data != NULL)
+      memcpy (Block, Data, sizeof (float) * S * S * Length);
+   else {
+      for (i = 0; i < S; i++) {
+         for (j = 0; j < S; j++) {
+            Gene &G = Org.OrgGenome.GetChromosome (i).GetGene (j);
+
+            for (k = 0; k < Length; k++)
+               Block [(i * S + j) * Length + k] = G.GetElement (k);
+         }
+      }
+   }
+
+   // Written under a temporary name and renamed over the target, so a
+   // process that has the old image mapped keeps it whole:
+   std::string Temp = FileName + ".tmp";
+
+   bool Written;
+
+   {
+      std::fstream File (Temp.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+
+      File.write (Buffer, H.FileSize);
+      File.flush ();
+
+      Written = File.good ();
+   }
+
+   delete [] Buffer;
+
+   if (!Written || rename (Temp.c_str (), FileName.c_str ()) != 0) {
+      remove (Temp.c_str ());
+
+      return false;
+   }
+
+   return true;
+}
+
+bool MappedOrganism::Open (std::string FileName) {
+   Close ();
+
+   int Handle = open (FileName.c_str (), O_RDONLY);
+
+   if (Handle < 0)
+      return false;
+
+   struct stat Info;
+
+   if (fstat (Handle, &Info) != 0 || Info.st_size < (off_t) sizeof (ImageHeader)) {
+      close (Handle);
+
+      return false;
+   }
+
+   void *Map = mmap (NULL, Info.st_size, PROT_READ, MAP_PRIVATE, Handle, 0);
+
+   // The mapping holds its own reference to the file:
+   close (Handle);
+
+   if (Map == MAP_FAILED)
+      return false;
+
+   Image     = (const char *) Map;
+   ImageSize = Info.st_size;
+
+   if (!Parse ()) {
+      Close ();
+
+      return false;
+   }
+
+   return true;
+}
+
+bool MappedOrganism::Parse () {
+   Header = (const ImageHeader *) Image;
+
+   if (memcmp (Header->Magic, ADAPTMAP_MAGIC, sizeof (Header->Magic)) != 0 ||
+       Header->Version != ADAPTMAP_VERSION ||
+       Header->HeaderSize != (int32_t) sizeof (ImageHeader) ||
+       Header->FileSize != (int64_t) ImageSize)
+      return false;
+
+   int64_t S = Header->StateCount;
+   int64_t K = Header->SensorCount;
+
+   // Bounds keep the section sizes below from overflowing:
+   if (S < 0 || K < 0 || S > 65536 || K > 65536)
+      return false;
+
+   if (Header->CurrentState < 0 || (S > 0 && Header->CurrentState >= S))
+      return false;
+
+   // Every section has to fit, in order, with its alignment:
+   if (Header->NameOffset < Header->HeaderSize ||
+       Header->ValueOffset < Header->NameOffset || Header->ValueOffset % sizeof (float) != 0 ||
+       Header->FactorOffset < Header->ValueOffset + (int64_t) sizeof (float) * K || Header->FactorOffset % sizeof (float) != 0 ||
+       Header->CoeffOffset < Header->FactorOffset + (int64_t) (2 * sizeof (float)) * (S + S * S) ||
+       Header->CoeffOffset % ADAPTAI_ALIGNMENT != 0 ||
+       Header->FileSize < Header->CoeffOffset + (int64_t) sizeof (float) * S * S * (1 + K))
+      return false;
+
+   StateCount   = S;
+   SensorCount  = K;
+   CurrentState = Header->CurrentState;
+
+   StateNames  = new std::string [StateCount];
+   SensorNames = new std::string [SensorCount];
+
+   const char *In = Image + Header->NameOffset;
+
+   for (int i = 0; i < StateCount + SensorCount; i++) {
+      int32_t Count;
+
+      if (In + sizeof (int32_t) > Image + Header->ValueOffset)
+         return false;
+
+      memcpy (&Count, In, sizeof (int32_t));
+
+      In += sizeof (int32_t);
+
+      if (Count < 0 || Count > Image + Header->ValueOffset - In)
+         return false;
+
+      if (i < StateCount)
+         StateNames [i].assign (In, Count);
+      else SensorNames [i - StateCount].assign (In, Count);
+
+      In += Count;
+   }
+
+   Values = new float [SensorCount + StateCount + 1];
+
+   memcpy (Values, Image + Header->ValueOffset, sizeof (float) * SensorCount);
+
+   Coeff = (const float *) (Image + Header->CoeffOffset);
+
+   return true;
+}
+
+bool MappedOrganism::Close () {
+   if (Image != NULL)
+      munmap ((void *) Image, ImageSize);
+
+   delete [] StateNames;
+   delete [] SensorNames;
+   delete [] Values;
+
+   Image     = NULL;
+   ImageSize = 0;
+
+   Header = NULL;
+   Coeff  = NULL;
+
+   StateCount = SensorCount = CurrentState = 0;
+
+   StateNames = SensorNames = NULL;
+
+   Values = NULL;
+
+   return true;
+}
+
+bool MappedOrganism::IsOpen () const {
+   return Image != NULL;
+}
+
+bool MappedOrganism::Store (Organism &Org) const {
+   if (Image == NULL)
+      return false;
+
+   int i, j;
+
+   int S      = StateCount;
+   int Length = 1 + SensorCount;
+
+   Org.SetStateCount (S);
+   Org.SetSensorCount (SensorCount);
+
+   for (i = 0; i < S; i++)
+      Org.States [i].Name = StateNames [i];
+
+   for (i = 0; i < SensorCount; i++) {
+      Org.Sensors [i].Name  = SensorNames [i];
+      Org.Sensors [i].Value = Values [i];
+   }
+
+   Org.CurrentState = CurrentState;
+
+   Org.Reindex ();
+
+   const float *Factors = (const float *) (Image + Header->FactorOffset);
+
+   // The genome goes over in its bulk buffer format, which keeps the
+   // mutation factors exactly as they are, where the setters would clamp:
+   size_t Genes = (size_t) S * S;
+
+   std::vector<char> Buffer (ADAPTAI_BULK_HEADER + 3 * sizeof (int) * (S + Genes) + sizeof (float) * Genes * Length);
+
+   int       Version = ADAPTAI_BULK_VERSION, GeneTotal = (int) Genes;
+   long long Bytes   = Buffer.size ();
+
+   char *Out = Buffer.data ();
+
+   memcpy (Out,      ADAPTAI_BULK_MAGIC, 4);
+   memcpy (Out + 4,  &Version,           sizeof (int));
+   memcpy (Out + 8,  &S,                 sizeof (int));
+   memcpy (Out + 12, &GeneTotal,         sizeof (int));
+   memcpy (Out + 16, &Bytes,             sizeof (long long));
+
+   char *Chroms = Out + ADAPTAI_BULK_HEADER;
+   char *Table  = Chroms + 3 * sizeof (int) * S;
+
+   for (i = 0; i < S; i++) {
+      int32_t Crossover;
+
+      memcpy (&Crossover, Factors + 2 * i, sizeof (int32_t));
+
+      int Cross = (Crossover != 0) ? 1 : 0;
+
+      memcpy (Chroms,     &S,                   sizeof (int));
+      memcpy (Chroms + 4, &Cross,               sizeof (int));
+      memcpy (Chroms + 8, &Factors [2 * i + 1], sizeof (float));
+
+      Chroms += 3 * sizeof (int);
+
+      for (j = 0; j < S; j++) {
+         char *G = Table + 3 * sizeof (int) * ((size_t) i * S + j);
+
+         memcpy (G,     &Length,                                sizeof (int));
+         memcpy (G + 4, &Factors [2 * S + 2 * (i * S + j)],     sizeof (float));
+         memcpy (G + 8, &Factors [2 * S + 2 * (i * S + j) + 1], sizeof (float));
+      }
+   }
+
+   memcpy (Table + 3 * sizeof (int) * Genes, Coeff, sizeof (float) * Genes * Length);
+
+   if (Org.OrgGenome.LoadBuffer (Buffer.data (), Buffer.size ()) == 0)
+      return false;
+
+   return Org.Invalidate ();
+}
+
+int MappedOrganism::GetStateCount () const {
+   return StateCount;
+}
+
+int MappedOrganism::GetSensorCount () const {
+   return SensorCount;
+}
+
+std::string MappedOrganism::GetStateName (int Index) const {
+   if (Index < 0 || Index >= StateCount)
+      return "";
+
+   return StateNames [Index];
+}
+
+int MappedOrganism::GetStateIndex (std::string_view Name) const {
+   for (int i = 0; i < StateCount; i++) {
+      if (StateNames [i] == Name)
+         return i;
+   }
+
+   return -1;
+}
+
+std::string MappedOrganism::GetSensorName (int Index) const {
+   if (Index < 0 || Index >= SensorCount)
+      return "";
+
+   return SensorNames [Index];
+}
+
+int MappedOrganism::GetSensorIndex (std::string_view Name) const {
+   for (int i = 0; i < SensorCount; i++) {
+      if (SensorNames [i] == Name)
+         return i;
+   }
+
+   return -1;
+}
+
+float MappedOrganism::GetSensorValue (int Index) const {
+   if (Index < 0 || Index >= SensorCount)
+      return 0.0F;
+
+   return Values [Index];
+}
+
+float MappedOrganism::GetSensorValue (std::string_view Name) const {
+   return GetSensorValue (GetSensorIndex (Name));
+}
+
+bool MappedOrganism::SetSensorValue (int Index, float Value) {
+   if (Index < 0 || Index >= SensorCount)
+      return false;
+
+   Values [Index] = Value;
+
+   return true;
+}
+
+bool MappedOrganism::SetSensorValue (std::string_view Name, float Value) {
+   return SetSensorValue (GetSensorIndex (Name), Value);
+}
+
+int MappedOrganism::GetCurrentState () const {
+   return CurrentState;
+}
+
+bool MappedOrganism::SetCurrentState (int Index) {
+   if (Index < 0 || Index >= StateCount)
+      return false;
+
+   CurrentState = Index;
+
+   return true;
+}
+
+const float *MappedOrganism::GetData () const {
+   return Coeff;
+}
+
+bool MappedOrganism::SetGenerator (Generator *G) {
+   Rng = G;
+
+   return true;
+}
+
+Generator &MappedOrganism::GetGenerator () const {
+   if (Rng != NULL)
+      return *Rng;
+
+   return AdaptAI::GetGenerator ();
+}
+
+bool MappedOrganism::UpdateState () {
+   if (StateCount <= 0)
+      return false;
+
+   int Stride = 1 + SensorCount;
+
+   float *Prob = Values + SensorCount;
+
+   EvaluateRow (Coeff + (size_t) CurrentState * StateCount * Stride, StateCount, Stride, Values, SensorCount, Prob);
+
+   bool Monotone = CumulateRow (Prob, StateCount);
+
+   int NextState = SampleCdf (Prob, StateCount, Monotone, GetGenerator ().Random ());
+
+   if (NextState >= 0)
+      CurrentState = NextState;
+
+   return true;
+}
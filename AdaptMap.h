@@ -0,0 +1,103 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptMap.h
+  Purpose:      Declaration for the AdaptOrg memory-mapped organism image.
+*****************************************************************************/
+
+#ifndef __ADAPTMAPH__
+#define __ADAPTMAPH__
+
+#include <stdint.h>
+
+#include "AdaptOrg.h"
+
+#define ADAPTMAP_MAGIC   "ADAPTMAP"
+#define ADAPTMAP_VERSION 1
+
+namespace AdaptOrg {
+
+   // Image file format, host byte order, offsets from the start of the file:
+   //
+   //    ImageHeader                          sizeof (ImageHeader)
+   //    Names        NameOffset              (int32 Length, chars) per state, then per sensor
+   //    Values       ValueOffset             float x SensorCount
+   //    Factors      FactorOffset            (int32 Crossover, float Chance) x StateCount, then
+   //                                         (float Chance, float Rate) x StateCount x StateCount
+   //    Coeff        CoeffOffset             float x StateCount x StateCount x (1 + SensorCount),
+   //                                         ADAPTAI_ALIGNMENT aligned, the contiguous genome layout
+   struct ImageHeader {
+      char    Magic [8];
+      int32_t Version, HeaderSize;
+      int32_t StateCount, SensorCount, CurrentState, Flags;
+      int64_t NameOffset, ValueOffset, FactorOffset, CoeffOffset, FileSize;
+   };
+
+   // Read-only organism backed by an mmap'ed image. Coefficients are used in
+   // place, so opening costs the same whatever the genome size; only names
+   // and sensor values are copied out. Samples exactly like an Organism in
+   // ADAPTORG_SAMPLE_CDF mode.
+   class MappedOrganism {
+      protected:
+         const char *Image;
+         size_t     ImageSize;
+
+         const ImageHeader *Header;
+         const float       *Coeff;
+
+         int StateCount, SensorCount, CurrentState;
+
+         std::string *StateNames, *SensorNames;
+
+         // Sensor values, followed by one row of weights:
+         float *Values;
+
+         // Random number source, NULL for the calling thread's generator:
+         Generator *Rng;
+
+         bool Parse ();
+
+      public:
+         MappedOrganism  ();
+         MappedOrganism  (const MappedOrganism &M) = delete;
+         ~MappedOrganism ();
+
+         MappedOrganism &operator = (const MappedOrganism &M) = delete;
+
+         // Replaces FileName in one rename; instances that have the old
+         // image open keep reading it until they close:
+         static bool Write (const Organism &Org, std::string FileName);
+
+         bool Open    (std::string FileName);
+         bool Close   ();
+         bool IsOpen  () const;
+
+         bool Store (Organism &Org) const;
+
+         int  GetStateCount  () const;
+         int  GetSensorCount () const;
+
+         std::string GetStateName  (int Index) const;
+         int         GetStateIndex (std::string_view Name) const;
+
+         std::string GetSensorName  (int Index) const;
+         int         GetSensorIndex (std::string_view Name) const;
+
+         float GetSensorValue (int Index) const;
+         float GetSensorValue (std::string_view Name) const;
+         bool  SetSensorValue (int Index, float Value);
+         bool  SetSensorValue (std::string_view Name, float Value);
+
+         int  GetCurrentState () const;
+         bool SetCurrentState (int Index);
+
+         const float *GetData () const;
+
+         bool       SetGenerator (Generator *G);
+         Generator &GetGenerator () const;
+
+         bool UpdateState ();
+   };
+}
+
+#endif
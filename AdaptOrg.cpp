@@ -5,10 +5,100 @@
   Purpose:      Implementation for the AdaptOrg class library.
 *****************************************************************************/
 
+#include <string.h>
+#include <utility>
+
 #include "AdaptOrg.h"
+#include "AdaptKern.h"
 
 using namespace AdaptOrg;
 
+NameIndex::NameIndex () {
+   Hashes   = NULL;
+   Slots    = NULL;
+   Capacity = 0;
+}
+
+NameIndex::NameIndex (const NameIndex &N) {
+   Hashes   = NULL;
+   Slots    = NULL;
+   Capacity = 0;
+
+   (*this) = N;
+}
+
+NameIndex::~NameIndex () {
+   delete [] Hashes;
+   delete [] Slots;
+}
+
+NameIndex &NameIndex::operator = (const NameIndex &N) {
+   if (this == &N)
+      return *this;
+
+   if (Capacity != N.Capacity) {
+      delete [] Hashes;
+      delete [] Slots;
+
+      Capacity = N.Capacity;
+
+      Hashes = (Capacity > 0) ? new unsigned int [Capacity] : NULL;
+      Slots  = (Capacity > 0) ? new int [Capacity] : NULL;
+   }
+
+   if (Capacity > 0) {
+      memcpy (Hashes, N.Hashes, sizeof (unsigned int) * Capacity);
+      memcpy (Slots,  N.Slots,  sizeof (int) * Capacity);
+   }
+
+   return *this;
+}
+
+void NameIndex::Swap (NameIndex &N) {
+   std::swap (Hashes, N.Hashes);
+   std::swap (Slots, N.Slots);
+   std::swap (Capacity, N.Capacity);
+}
+
+unsigned int NameIndex::Hash (std::string_view Name) {
+   unsigned int H = 2166136261U;
+
+   for (size_t i = 0; i < Name.size (); i++) {
+      H ^= (unsigned char) Name [i];
+      H *= 16777619U;
+   }
+
+   return H;
+}
+
+bool NameIndex::Reserve (int Count) {
+   if (Count < 0)
+      return false;
+
+   // Power of two, at most half full:
+   int Size = 0;
+
+   if (Count > 0) {
+      for (Size = 8; Size < 2 * Count; Size *= 2)
+         ;
+   }
+
+   if (Size != Capacity) {
+      delete [] Hashes;
+      delete [] Slots;
+
+      Capacity = Size;
+
+      Hashes = (Capacity > 0) ? new unsigned int [Capacity] : NULL;
+      Slots  = (Capacity > 0) ? new int [Capacity] : NULL;
+   }
+
+   for (int i = 0; i < Capacity; i++)
+      Slots [i] = -1;
+
+   return true;
+}
+
 Organism::State::State () {
 }
 
@@ -143,6 +233,77 @@ bool Organism::Free () {
 
    CurrentState = 0;
 
+   Reindex ();
+
+   delete [] Workspace;
+
+   Workspace = NULL;
+
+   FreeCache ();
+
+   return true;
+}
+
+bool Organism::FreeCache () {
+   delete [] RowInputs;
+   delete [] AliasProb;
+   delete [] AliasIndex;
+   delete [] RowFlags;
+   delete [] RowWeights;
+   delete [] RowCdf;
+   delete [] RowAge;
+
+   RowInputs  = NULL;
+   AliasProb  = NULL;
+   AliasIndex = NULL;
+   RowFlags   = NULL;
+
+   RowWeights = RowCdf = NULL;
+   RowAge     = NULL;
+
+   return true;
+}
+
+bool Organism::Reserve () {
+   // Scratch room for one row of weights plus a packed copy of the sensors:
+   delete [] Workspace;
+
+   Workspace = new float [StateCount + SensorCount + 1];
+
+   FreeCache ();
+
+   if (Sampling == ADAPTORG_SAMPLE_ALIAS) {
+      // One alias table per state, plus room for BuildAlias' work list:
+      RowInputs  = new float [StateCount * SensorCount + 1];
+      AliasProb  = new float [StateCount * StateCount + 1];
+      AliasIndex = new int   [StateCount * StateCount + StateCount + 1];
+      RowFlags   = new char  [StateCount + 1];
+   }
+   else if (Sampling == ADAPTORG_SAMPLE_CACHED) {
+      RowInputs  = new float [StateCount * SensorCount + 1];
+      RowWeights = new float [StateCount * StateCount + 1];
+      RowCdf     = new float [StateCount * StateCount + 1];
+      RowAge     = new int   [StateCount + 1];
+      RowFlags   = new char  [StateCount + 1];
+   }
+
+   return Invalidate ();
+}
+
+bool Organism::Reindex () {
+   StateNames.Build (States, StateCount);
+   SensorNames.Build (Sensors, SensorCount);
+
+   return true;
+}
+
+bool Organism::Invalidate (bool Rehash) {
+   if (RowFlags != NULL)
+      memset (RowFlags, 0, StateCount);
+
+   if (Rehash)
+      OrgGenome.InvalidateHash ();
+
    return true;
 }
 
@@ -150,25 +311,123 @@ Organism::Organism  () {
    States = NULL;
    Sensors   = NULL;
 
+   Workspace = NULL;
+
+   Rng = NULL;
+
+   BoundInputs = NULL;
+   BoundStride = 1;
+
+   Sampling   = ADAPTORG_SAMPLE_CDF;
+   RowInputs  = AliasProb = NULL;
+   AliasIndex = NULL;
+   RowFlags   = NULL;
+
+   RowWeights = RowCdf = NULL;
+   RowAge     = NULL;
+
    StateCount = SensorCount = CurrentState = 0;
+
+   // Transition coefficients live in one StateCount x StateCount x (1 + SensorCount) block:
+   OrgGenome.SetContiguous (true);
 }
 
 Organism::Organism (const Organism &Org) {
+   States  = NULL;
+   Sensors = NULL;
+
+   Workspace = NULL;
+
+   Rng = NULL;
+
+   BoundInputs = NULL;
+   BoundStride = 1;
+
+   Sampling   = ADAPTORG_SAMPLE_CDF;
+   RowInputs  = AliasProb = NULL;
+   AliasIndex = NULL;
+   RowFlags   = NULL;
+
+   RowWeights = RowCdf = NULL;
+   RowAge     = NULL;
+
+   StateCount = SensorCount = CurrentState = 0;
+
    (*this) = Org;
 }
 
+Organism::Organism (Organism &&Org) noexcept : OrgGenome (std::move (Org.OrgGenome)) {
+   States  = NULL;
+   Sensors = NULL;
+
+   Workspace = NULL;
+
+   Rng = NULL;
+
+   BoundInputs = NULL;
+   BoundStride = 1;
+
+   Sampling   = ADAPTORG_SAMPLE_CDF;
+   RowInputs  = AliasProb = NULL;
+   AliasIndex = NULL;
+   RowFlags   = NULL;
+
+   RowWeights = RowCdf = NULL;
+   RowAge     = NULL;
+
+   StateCount = SensorCount = CurrentState = 0;
+
+   Swap (Org);
+}
+
 Organism::~Organism () {
    Free ();
 }
 
-Organism &Organism::operator = (const Organism &Org) {
-   Free ();
+void Organism::Swap (Organism &Org) {
+   // Everything but the genome and the generator binding:
+   std::swap (States, Org.States);
+   std::swap (Sensors, Org.Sensors);
+
+   std::swap (StateCount, Org.StateCount);
+   std::swap (SensorCount, Org.SensorCount);
+   std::swap (CurrentState, Org.CurrentState);
+
+   StateNames.Swap (Org.StateNames);
+   SensorNames.Swap (Org.SensorNames);
+
+   std::swap (Workspace, Org.Workspace);
+
+   std::swap (Sampling, Org.Sampling);
+   std::swap (RowInputs, Org.RowInputs);
+   std::swap (AliasProb, Org.AliasProb);
+   std::swap (AliasIndex, Org.AliasIndex);
+   std::swap (RowFlags, Org.RowFlags);
+   std::swap (RowWeights, Org.RowWeights);
+   std::swap (RowCdf, Org.RowCdf);
+   std::swap (RowAge, Org.RowAge);
+}
+
+bool Organism::CopyStructure (const Organism &Org) {
+   bool Reshape = (StateCount != Org.StateCount || SensorCount != Org.SensorCount ||
+                   Sampling != Org.Sampling || Workspace == NULL);
+
+   // Arrays of the right size are reused:
+   if (StateCount != Org.StateCount) {
+      delete [] States;
+
+      StateCount = Org.StateCount;
+
+      States = new State [StateCount];
+   }
 
-   StateCount  = Org.StateCount;
-   SensorCount = Org.SensorCount;
+   if (SensorCount != Org.SensorCount) {
+      delete [] Sensors;
 
-   States  = new State  [StateCount];
-   Sensors = new Sensor [SensorCount];
+      SensorCount = Org.SensorCount;
+
+      Sensors = new Sensor [SensorCount];
+   }
 
    int i;
 
@@ -178,26 +437,83 @@ Organism &Organism::operator = (const Organism &Org) {
    for (i = 0; i < SensorCount; i++)
       Sensors [i] = Org.Sensors [i];
 
+   StateNames  = Org.StateNames;
+   SensorNames = Org.SensorNames;
+
+   CurrentState = 0;
+
+   Sampling = Org.Sampling;
+
+   // The generator binding stays with this instance.
+
+   if (Reshape)
+      return Reserve ();
+
+   return Invalidate ();
+}
+
+Organism &Organism::operator = (const Organism &Org) {
+   if (this == &Org)
+      return *this;
+
+   CopyStructure (Org);
+
    OrgGenome = Org.OrgGenome;
 
    return *this;
 }
 
+Organism &Organism::operator = (Organism &&Org) {
+   if (this == &Org)
+      return *this;
+
+   Free ();
+
+   Swap (Org);
+
+   OrgGenome = std::move (Org.OrgGenome);
+
+   return *this;
+}
+
 Organism Organism::operator + (const Organism &Org) const {
+   return Cross (Org, GetGenerator ());
+}
+
+Organism Organism::Cross (const Organism &Org, Generator &G) const {
    Organism Temp;
 
+   Cross (Org, Temp, G);
+
+   return Temp;
+}
+
+bool Organism::Cross (const Organism &Org, Organism &Child, Generator &G) const {
    if (StateCount != Org.StateCount || SensorCount != Org.SensorCount) {
       throw;
    }
 
-   Temp = *this;
+   // Child must not overwrite a parent halfway through:
+   if (&Child == this || &Child == &Org) {
+      Organism Temp;
 
-   Temp.OrgGenome = OrgGenome + Org.OrgGenome;
+      Temp.SetGenomePool (Child.GetGenomePool ());
+
+      Cross (Org, Temp, G);
+
+      Child = std::move (Temp);
+
+      return true;
+   }
+
+   Child.CopyStructure (*this);
+
+   OrgGenome.Cross (Org.OrgGenome, Child.OrgGenome, G);
 
    // Mutate the offspring's genome:
-   Temp.Mutate ();
+   Child.Mutate (G);
 
-   return Temp;
+   return true;
 }
 
 std::string Organism::GetStateName (int Index) const {
@@ -222,31 +538,33 @@ bool Organism::SetStateName (int Index, std::string Name) {
 
    States [Index].SetName (Name);
 
-   return true;
+   return StateNames.Build (States, StateCount);
 }
 
 bool Organism::SetStateCount (int Count) {
    if (Count < 0)
       return false;
 
-   // One chromosome for each state:
-   StateCount = Count;
+   if (Count != StateCount) {
+      // Surviving states keep their names:
+      State *NewStates = new State [Count];
 
-   if (States == NULL) {
-      States = new State [StateCount];
+      for (int i = 0; i < Count && i < StateCount; i++)
+         NewStates [i] = States [i];
+
+      delete [] States;
+
+      States = NewStates;
    }
 
-   if (!OrgGenome.SetChromosomeCount (StateCount))
-      return false;
+   StateCount = Count;
 
-   // StateCount genes for each state:
-   for (int i = 0; i < StateCount; i++) {
-      Chromosome &Chrom = OrgGenome.GetChromosome (i);
+   StateNames.Build (States, StateCount);
 
-      Chrom.SetGeneCount (StateCount);
-   }
+   if (CurrentState >= StateCount)
+      CurrentState = 0;
 
-   // Now set sensor count since it depends on state count:
+   // Now set sensor count since the genome's shape depends on both:
    return SetSensorCount (SensorCount);
 }
 
@@ -254,46 +572,39 @@ int Organism::GetStateCount () const {
    return StateCount;
 }
 
-int Organism::GetStateIndex (std::string Name) const {
-   for (int i = 0; i < StateCount; i++) {
-      if (Name == States [i].Name) {
-         return i;
-      }
-   }
-
-   return -1;
+int Organism::GetStateIndex (std::string_view Name) const {
+   return StateNames.Find (States, Name);
 }
 
-float Organism::GetSensorValue (std::string Name) const {
-   for (int i = 0; i < SensorCount; i++) {
-      if (Name == Sensors [i].Name)
-         return Sensors [i].Value;
-   }
+StateHandle Organism::FindState (std::string_view Name) const {
+   return StateHandle (StateNames.Find (States, Name));
+}
 
-   return 0.0F;
+float Organism::GetSensorValue (std::string_view Name) const {
+   return GetSensorValue (SensorNames.Find (Sensors, Name));
 }
 
 float Organism::GetSensorValue (int Index) const {
    if (Index < 0 || Index >= SensorCount)
       return 0.0F;
 
+   if (BoundInputs != NULL)
+      return BoundInputs [(size_t) Index * BoundStride];
+
    return Sensors [Index].Value;
 }
 
-bool Organism::SetSensorValue (std::string Name, float Value) {
-   for (int i = 0; i < SensorCount; i++) {
-      if (Name == Sensors [i].Name) {
-         Sensors [i].SetValue (Value);
-
-         return true;
-      }
-   }
+float Organism::GetSensorValue (SensorHandle H) const {
+   return GetSensorValue (H.Index);
+}
 
-   return false;
+bool Organism::SetSensorValue (std::string_view Name, float Value) {
+   return SetSensorValue (SensorNames.Find (Sensors, Name), Value);
 }
 
 bool Organism::SetSensorValue (int Index, float Value) {
-   if (Index < 0 || Index >= SensorCount)
+   // Bound values belong to the caller:
+   if (Index < 0 || Index >= SensorCount || BoundInputs != NULL)
       return false;
 
    Sensors [Index].SetValue (Value);
@@ -301,6 +612,10 @@ bool Organism::SetSensorValue (int Index, float Value) {
    return true;
 }
 
+bool Organism::SetSensorValue (SensorHandle H, float Value) {
+   return SetSensorValue (H.Index, Value);
+}
+
 std::string Organism::GetSensorName (int Index) const {
    if (Index < 0 || Index >= SensorCount)
       return NULL;
@@ -323,7 +638,7 @@ bool Organism::SetSensorName (int Index, std::string Name) {
 
    Sensors [Index].SetName (Name);
 
-   return true;
+   return SensorNames.Build (Sensors, SensorCount);
 }
 
 bool Organism::SetSensorCount (int Count) {
@@ -332,41 +647,39 @@ bool Organism::SetSensorCount (int Count) {
       return false;
    }
    
-   SensorCount = Count;
+   if (Count != SensorCount) {
+      // Surviving sensors keep their names and values:
+      Sensor *NewSensors = new Sensor [Count];
 
-   if (Count > 0) {
-      if (Sensors == NULL) {
-         Sensors = new Sensor [SensorCount];
-      }
+      for (int i = 0; i < Count && i < SensorCount; i++)
+         NewSensors [i] = Sensors [i];
+
+      delete [] Sensors;
+
+      Sensors = NewSensors;
    }
 
-   for (int i = 0; i < StateCount; i++) {
-      Chromosome &Chrom = OrgGenome.GetChromosome (i);
+   SensorCount = Count;
 
-      for (int j = 0; j < StateCount; j++) {
-         Gene &G = Chrom.GetGene (j);
+   SensorNames.Build (Sensors, SensorCount);
 
-         // Allocate enough room for each coefficient
-         // (base + sensor coeff's):
-         G.SetLength (1 + SensorCount);
-      }
-   }
+   Reserve ();
 
-   return true;
+   // One chromosome for each state, StateCount genes for each chromosome,
+   // and enough room in each gene for every coefficient (base + sensor coeff's):
+   return OrgGenome.SetShape (StateCount, StateCount, 1 + SensorCount);
 }
 
 int Organism::GetSensorCount () const {
    return SensorCount;
 }
 
-int Organism::GetSensorIndex (std::string Name) const {
-   for (int i = 0; i < SensorCount; i++) {
-      if (Name == Sensors [i].Name) {
-         return i;
-      }
-   }
+int Organism::GetSensorIndex (std::string_view Name) const {
+   return SensorNames.Find (Sensors, Name);
+}
 
-   return -1;
+SensorHandle Organism::FindSensor (std::string_view Name) const {
+   return SensorHandle (SensorNames.Find (Sensors, Name));
 }
 
 bool Organism::SetTransition (int Index1, int Index2, float BaseChance, const float *SensorCoeff) {
@@ -382,7 +695,7 @@ bool Organism::SetTransition (int Index1, int Index2, float BaseChance, const fl
    for (int i = 0; i < SensorCount; i++)
       G.SetElement (1 + i, SensorCoeff [i]);
 
-   return true;
+   return Invalidate ();
 }
 
 int Organism::GetCurrentState () const {
@@ -394,16 +707,8 @@ bool Organism::GetCurrentState (std::string* Name) const {
    return true;
 }
 
-bool Organism::SetCurrentState (std::string Name) {
-   for (int i = 0; i < StateCount; i++) {
-		if (States [i].Name == Name) {
-         CurrentState = i;
-
-         return true;
-      }
-   }
-
-   return false;
+bool Organism::SetCurrentState (std::string_view Name) {
+   return SetCurrentState (StateNames.Find (States, Name));
 }
 
 bool Organism::SetCurrentState (int Index) {
@@ -415,70 +720,341 @@ bool Organism::SetCurrentState (int Index) {
    return true;
 }
 
+bool Organism::SetCurrentState (StateHandle H) {
+   return SetCurrentState (H.Index);
+}
+
+bool Organism::IsCurrentState (StateHandle H) const {
+   return H.Index == CurrentState && H.Index < StateCount;
+}
+
+bool Organism::SetContiguous (bool State) {
+   return OrgGenome.SetContiguous (State);
+}
+
+bool Organism::GetContiguous () const {
+   return OrgGenome.GetContiguous ();
+}
+
+bool Organism::SetGenomePool (GenomePool *P) {
+   return OrgGenome.SetPool (P);
+}
+
+GenomePool *Organism::GetGenomePool () const {
+   return OrgGenome.GetPool ();
+}
+
+bool Organism::SetSampling (int Mode) {
+   if (Mode != ADAPTORG_SAMPLE_CDF && Mode != ADAPTORG_SAMPLE_ALIAS && Mode != ADAPTORG_SAMPLE_CACHED)
+      return false;
+
+   Sampling = Mode;
+
+   return Reserve ();
+}
+
+int Organism::GetSampling () const {
+   return Sampling;
+}
+
+bool Organism::SetGenerator (Generator *G) {
+   Rng = G;
+
+   return true;
+}
+
+Generator &Organism::GetGenerator () const {
+   if (Rng != NULL)
+      return *Rng;
+
+   return AdaptAI::GetGenerator ();
+}
+
+bool Organism::BindSensors (const float *Inputs, int SensorStride) {
+   if (Inputs == NULL || SensorStride < 1)
+      return false;
+
+   BoundInputs = Inputs;
+   BoundStride = SensorStride;
+
+   return true;
+}
+
+bool Organism::UnbindSensors () {
+   BoundInputs = NULL;
+   BoundStride = 1;
+
+   return true;
+}
+
+const float *Organism::GetBoundSensors () const {
+   return BoundInputs;
+}
+
 bool Organism::Mutate () {
-   return OrgGenome.Mutate ();
+   return Mutate (GetGenerator ());
+}
+
+bool Organism::Mutate (Generator &G) {
+   Invalidate (false);
+
+   return OrgGenome.Mutate (G);
 }
 
 bool Organism::MutateMutationFactors (float Chance, float Rate) {
-   return OrgGenome.MutateMutationFactors (Chance, Rate);
+   return OrgGenome.MutateMutationFactors (Chance, Rate, GetGenerator ());
 }
 
-bool Organism::UpdateState () {
-   float *Prob = new float [StateCount];
+bool Organism::EvaluateState (int Index, const float *Inputs, float *Weights) const {
+   int i;
 
-   float TotalProb = 0.0F;
+   const float *Data = OrgGenome.GetData ();
 
-   int i;
+   if (Data != NULL) {
+      // Contiguous storage, the whole row is one small matrix-vector product:
+      int Stride = 1 + SensorCount;
+
+      EvaluateRow (Data + Index * StateCount * Stride, StateCount, Stride, Inputs, SensorCount, Weights);
+
+      return true;
+   }
 
-   Chromosome &Chrom = OrgGenome.GetChromosome (CurrentState);
+   Chromosome &Chrom = OrgGenome.GetChromosome (Index);
 
    for (i = 0; i < StateCount; i++) {
       Gene &G = Chrom.GetGene (i);
 
       // Base chance:
-      Prob [i]  = G.GetElement (0);
-
-      TotalProb  += Prob [i];
+      Weights [i] = G.GetElement (0);
 
       // Sensor coefficients:
-      for (int j = 1; j <= SensorCount; j++) {
-         float p = G.GetElement (j) * Sensors [j - 1].Value;
-         
-         Prob [i] += p;
+      for (int j = 1; j <= SensorCount; j++)
+         Weights [i] += G.GetElement (j) * Inputs [j - 1];
+   }
+
+   return true;
+}
 
-         TotalProb  += p;
+bool Organism::UpdateRow (int Index, const float *Inputs) {
+   float *Snapshot = RowInputs  + Index * SensorCount;
+   float *Weights  = RowWeights + Index * StateCount;
+
+   // Read only, so data shared with other copies stays shared:
+   const float *Data = ((const Genome &) OrgGenome).GetData ();
+
+   int i, j, Changed = 0;
+
+   if (RowFlags [Index] != 0) {
+      for (i = 0; i < SensorCount; i++) {
+         if (Snapshot [i] != Inputs [i])
+            Changed++;
       }
+
+      // Nothing moved, the cached CDF still holds:
+      if (Changed == 0)
+         return true;
    }
 
-   // Normalize probability:
-   for (i = 0; i < StateCount; i++)
-      Prob [i] /= TotalProb;
+   if (RowFlags [Index] == 0 || Data == NULL || RowAge [Index] >= ADAPTORG_CACHE_REFRESH || 2 * Changed > SensorCount + 1) {
+      EvaluateState (Index, Inputs, Weights);
 
-   // cdf - cumulative distribution function
-   for (i = StateCount - 1; i >= 0; i--) {
-      for (int j = 0; j < i; j++)
-         Prob [i] += Prob [j];
+      RowAge [Index] = 0;
    }
+   else {
+      // A changed sensor moves each weight by its coefficient times the delta:
+      int Stride = 1 + SensorCount;
 
-   float Choice = Random ();
+      const float *Row = Data + Index * StateCount * Stride;
 
-   int NextState = CurrentState;
+      for (i = 0; i < SensorCount; i++) {
+         if (Snapshot [i] == Inputs [i])
+            continue;
 
-   for (i = 0; i < StateCount; i++) {
-      if (Choice <= Prob [i]) {
-         NextState = i;
+         float Delta = Inputs [i] - Snapshot [i];
 
-         break;
+         for (j = 0; j < StateCount; j++)
+            Weights [j] += Row [j * Stride + 1 + i] * Delta;
       }
+
+      RowAge [Index]++;
+   }
+
+   memcpy (Snapshot, Inputs, sizeof (float) * SensorCount);
+
+   float *Cdf = RowCdf + Index * StateCount;
+
+   memcpy (Cdf, Weights, sizeof (float) * StateCount);
+
+   RowFlags [Index] = CumulateRow (Cdf, StateCount) ? 1 : 2;
+
+   return true;
+}
+
+int Organism::SampleState (int Index, const float *Inputs) {
+   Generator &Source = GetGenerator ();
+
+   float *Prob = Workspace;
+
+   if (Sampling == ADAPTORG_SAMPLE_CACHED) {
+      UpdateRow (Index, Inputs);
+
+      return SampleCdf (RowCdf + Index * StateCount, StateCount, RowFlags [Index] == 1, Source.Random ());
    }
 
-   CurrentState = NextState;
+   if (Sampling == ADAPTORG_SAMPLE_ALIAS) {
+      float *Snapshot = RowInputs + Index * SensorCount;
+
+      // Rebuild the row's table only when its sensor values changed:
+      if (RowFlags [Index] == 0 || memcmp (Snapshot, Inputs, sizeof (float) * SensorCount) != 0) {
+         EvaluateState (Index, Inputs, Prob);
+
+         if (BuildAlias (Prob, StateCount, AliasProb + Index * StateCount,
+                         AliasIndex + Index * StateCount, AliasIndex + StateCount * StateCount))
+            RowFlags [Index] = 1;
+         else RowFlags [Index] = 2;
+
+         memcpy (Snapshot, Inputs, sizeof (float) * SensorCount);
+
+         // Negative or zero weights have no alias table, use the CDF:
+         if (RowFlags [Index] == 2) {
+            bool Monotone = CumulateRow (Prob, StateCount);
+
+            return SampleCdf (Prob, StateCount, Monotone, Source.Random ());
+         }
+      }
+
+      if (RowFlags [Index] == 1) {
+         float Choice = Source.Random ();
+
+         return SampleAlias (AliasProb + Index * StateCount, AliasIndex + Index * StateCount,
+                             StateCount, Choice, Source.Random ());
+      }
+   }
+
+   EvaluateState (Index, Inputs, Prob);
+
+   // cdf - cumulative distribution function
+   bool Monotone = CumulateRow (Prob, StateCount);
+
+   return SampleCdf (Prob, StateCount, Monotone, Source.Random ());
+}
+
+const float *Organism::GatherInputs () {
+   // Densely bound sensors are read in place, anything else is gathered:
+   if (BoundInputs != NULL && BoundStride == 1)
+      return BoundInputs;
+
+   float *Gather = Workspace + StateCount;
+
+   for (int i = 0; i < SensorCount; i++)
+      Gather [i] = (BoundInputs != NULL) ? BoundInputs [(size_t) i * BoundStride] : Sensors [i].Value;
+
+   return Gather;
+}
+
+bool Organism::UpdateState () {
+   if (StateCount <= 0)
+      return false;
+
+   int NextState = SampleState (CurrentState, GatherInputs ());
 
-   delete [] Prob;
+   if (NextState >= 0)
+      CurrentState = NextState;
 
    return true;
 }
 
+int Organism::Run (int Steps, int *Trajectory) {
+   return RunSteps (Steps, -1, NULL, Trajectory);
+}
+
+int Organism::RunUntil (int MaxSteps, int Absorbing, int *Trajectory) {
+   return RunSteps (MaxSteps, Absorbing, NULL, Trajectory);
+}
+
+int Organism::RunUntil (int MaxSteps, const std::function<bool (int State)> &Stop, int *Trajectory) {
+   return RunSteps (MaxSteps, -1, &Stop, Trajectory);
+}
+
+int Organism::RunSteps (int Steps, int Absorbing, const std::function<bool (int State)> *Stop, int *Trajectory) {
+   if (StateCount <= 0 || Steps <= 0)
+      return 0;
+
+   if (CurrentState == Absorbing || (Stop != NULL && (*Stop) (CurrentState)))
+      return 0;
+
+   Generator &Source = GetGenerator ();
+
+   const float *Inputs = GatherInputs ();
+
+   int S = StateCount;
+
+   bool Alias = (Sampling == ADAPTORG_SAMPLE_ALIAS);
+
+   // Rows are compiled on first visit. Flags: 0 = not yet, 1 = alias table,
+   // 2 = monotone CDF, 3 = CDF with negative weights:
+   float *Table = new float [(size_t) S * S];
+   int   *Index = Alias ? new int [(size_t) S * S + S] : NULL;
+   char  *Flags = new char  [S];
+
+   memset (Flags, 0, S);
+
+   int Step;
+
+   for (Step = 0; Step < Steps; Step++) {
+      int Row = CurrentState;
+
+      float *Cdf = Table + (size_t) Row * S;
+
+      if (Flags [Row] == 0) {
+         EvaluateState (Row, Inputs, Workspace);
+
+         if (Alias && BuildAlias (Workspace, S, Cdf, Index + (size_t) Row * S, Index + (size_t) S * S))
+            Flags [Row] = 1;
+         else {
+            memcpy (Cdf, Workspace, sizeof (float) * S);
+
+            Flags [Row] = CumulateRow (Cdf, S) ? 2 : 3;
+         }
+      }
+
+      int Next;
+
+      if (Flags [Row] == 1) {
+         float Choice = Source.Random ();
+
+         Next = SampleAlias (Cdf, Index + (size_t) Row * S, S, Choice, Source.Random ());
+      }
+      else Next = SampleCdf (Cdf, S, Flags [Row] == 2, Source.Random ());
+
+      if (Next >= 0)
+         CurrentState = Next;
+
+      if (Trajectory != NULL)
+         Trajectory [Step] = CurrentState;
+
+      if (CurrentState == Absorbing || (Stop != NULL && (*Stop) (CurrentState))) {
+         Step++;
+
+         break;
+      }
+   }
+
+   delete [] Table;
+   delete [] Index;
+   delete [] Flags;
+
+   return Step;
+}
+
+unsigned long long Organism::GetContentHash () const {
+   return OrgGenome.GetHash ();
+}
+
+bool Organism::SameGenome (const Organism &Org) const {
+   return OrgGenome == Org.OrgGenome;
+}
+
 bool Organism::Save (std::fstream &File) const {
    // File format:
    //          StateCount         sizeof (int)
@@ -515,38 +1091,128 @@ bool Organism::Save (std::fstream &File) const {
 }
 
 bool Organism::Load (std::fstream &File) {
-   File.read ((char *) &StateCount,   sizeof (int));
-   File.read ((char *) &SensorCount,  sizeof (int));
-   File.read ((char *) &CurrentState, sizeof (int));
-   
+   int S = -1, K = -1, Current = 0;
+
+   File.read ((char *) &S,       sizeof (int));
+   File.read ((char *) &K,       sizeof (int));
+   File.read ((char *) &Current, sizeof (int));
+
+   if (!File.good () || S < 0 || K < 0 || (S > 0 && (Current < 0 || Current >= S)))
+      return false;
+
+   // Read into a scratch organism, this one only changes on success, so the
+   // counts never disagree with the arrays sized for them:
+   Organism Temp;
+
+   Temp.StateCount   = S;
+   Temp.SensorCount  = K;
+   Temp.CurrentState = Current;
+   Temp.Sampling     = Sampling;
+
+   Temp.OrgGenome.SetContiguous (OrgGenome.GetContiguous ());
+   Temp.OrgGenome.SetPool (OrgGenome.GetPool ());
+
    // Allocate memory for states:
-   delete [] States;
-   States = new State [StateCount];
+   Temp.States = new State [S];
 
    // Load states:
    int i;
-   for (i = 0; i < StateCount; i++) {
-      if (!States [i].Load (File))
+   for (i = 0; i < S; i++) {
+      if (!Temp.States [i].Load (File))
          return false;
    }
 
    // Allocate memory for the sensors:
-   delete [] Sensors;
-   Sensors = new Sensor [SensorCount];
+   Temp.Sensors = new Sensor [K];
 
    // Load sensors:
-   for (i = 0; i < SensorCount; i++) {
-      if (!Sensors [i].Load (File))
+   for (i = 0; i < K; i++) {
+      if (!Temp.Sensors [i].Load (File))
          return false;
    }
 
+   Temp.Reindex ();
+
    // Load the genome:
-   if (!OrgGenome.Load (File))
+   if (!Temp.OrgGenome.Load (File))
       return false;
 
    if (!File.good ())
       return false;
 
-   return true;
+   Temp.Reserve ();
+
+   Swap (Temp);
+
+   OrgGenome = std::move (Temp.OrgGenome);
+
+   return Invalidate ();
+}
+
+bool Organism::SaveDelta (const Organism &Base, const Organism *Mate, std::vector<char> &Out) const {
+   // Delta format:
+   //          CurrentState       sizeof (int)
+   //          Sensor values      sizeof (float) * SensorCount
+   //          OrgGenome          varies, see Genome::SaveDelta
+   if (StateCount != Base.StateCount || SensorCount != Base.SensorCount)
+      return false;
+
+   int i;
+
+   for (i = 0; i < StateCount; i++) {
+      if (States [i].Name != Base.States [i].Name)
+         return false;
+   }
+
+   for (i = 0; i < SensorCount; i++) {
+      if (Sensors [i].Name != Base.Sensors [i].Name)
+         return false;
+   }
+
+   const char *Bytes = (const char *) &CurrentState;
+
+   Out.insert (Out.end (), Bytes, Bytes + sizeof (int));
+
+   for (i = 0; i < SensorCount; i++) {
+      Bytes = (const char *) &Sensors [i].Value;
+
+      Out.insert (Out.end (), Bytes, Bytes + sizeof (float));
+   }
+
+   return OrgGenome.SaveDelta (&Base.OrgGenome, (Mate != NULL) ? &Mate->OrgGenome : NULL, Out);
+}
+
+size_t Organism::LoadDelta (const Organism &Base, const Organism *Mate, const char *Buffer, size_t Size) {
+   if (Buffer == NULL || &Base == this || Mate == this)
+      return 0;
+
+   size_t Head = sizeof (int) + sizeof (float) * Base.SensorCount;
+
+   if (Size < Head)
+      return 0;
+
+   if (!CopyStructure (Base))
+      return 0;
+
+   int State;
+
+   memcpy (&State, Buffer, sizeof (int));
+
+   if (State < 0 || (State >= StateCount && State != 0))
+      return 0;
+
+   CurrentState = State;
+
+   for (int i = 0; i < SensorCount; i++)
+      memcpy (&Sensors [i].Value, Buffer + sizeof (int) + sizeof (float) * i, sizeof (float));
+
+   size_t Used = OrgGenome.LoadDelta (&Base.OrgGenome, (Mate != NULL) ? &Mate->OrgGenome : NULL, Buffer + Head, Size - Head);
+
+   if (Used == 0)
+      return 0;
+
+   Invalidate ();
+
+   return Head + Used;
 }
 
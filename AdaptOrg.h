@@ -10,14 +10,127 @@
 
 #include <math.h>
 #include <string>
+#include <string_view>
 #include <fstream>
+#include <functional>
 
 #include "AdaptAI.h"
 
+#define ADAPTORG_SAMPLE_CDF    0
+#define ADAPTORG_SAMPLE_ALIAS  1
+#define ADAPTORG_SAMPLE_CACHED 2
+
+// Delta updates a cached row takes before it is recomputed from scratch,
+// bounding rounding drift:
+#define ADAPTORG_CACHE_REFRESH 64
+
 using namespace AdaptAI;
 
 namespace AdaptOrg {
+   class OrganismBatch;
+   class MappedOrganism;
+   class TransitionMatrix;
+   class SparseOrganism;
+
+   template <int States, int Sensors> class FixedOrganism;
+
+   // Open-addressed hash from a name to the lowest index carrying it, over
+   // any array of items with a Name member. Rebuilt whenever a name or the
+   // count changes; lookups are O(1) and never allocate.
+   class NameIndex {
+      protected:
+         unsigned int *Hashes;
+         int          *Slots;
+         int          Capacity;
+
+         bool Reserve (int Count);
+
+      public:
+         NameIndex  ();
+         NameIndex  (const NameIndex &N);
+         ~NameIndex ();
+
+         NameIndex &operator = (const NameIndex &N);
+
+         void Swap (NameIndex &N);
+
+         // 32-bit FNV-1a:
+         static unsigned int Hash (std::string_view Name);
+
+         template <class T> bool Build (const T *Items, int Count);
+         template <class T> int  Find  (const T *Items, std::string_view Name) const;
+   };
+
+   template <class T> bool NameIndex::Build (const T *Items, int Count) {
+      if (!Reserve (Count))
+         return false;
+
+      for (int i = 0; i < Count; i++) {
+         unsigned int H = Hash (Items [i].Name);
+
+         int Slot = H & (Capacity - 1);
+
+         // Duplicates keep the first index, like a linear scan would find:
+         while (Slots [Slot] >= 0) {
+            if (Hashes [Slot] == H && Items [Slots [Slot]].Name == Items [i].Name)
+               break;
+
+            Slot = (Slot + 1) & (Capacity - 1);
+         }
+
+         if (Slots [Slot] < 0) {
+            Hashes [Slot] = H;
+            Slots  [Slot] = i;
+         }
+      }
+
+      return true;
+   }
+
+   template <class T> int NameIndex::Find (const T *Items, std::string_view Name) const {
+      if (Capacity == 0)
+         return -1;
+
+      unsigned int H = Hash (Name);
+
+      for (int Slot = H & (Capacity - 1); Slots [Slot] >= 0; Slot = (Slot + 1) & (Capacity - 1)) {
+         if (Hashes [Slot] == H && Items [Slots [Slot]].Name == Name)
+            return Slots [Slot];
+      }
+
+      return -1;
+   }
+
+   // A state or sensor resolved once by name, for lookups in a hot loop.
+   // Stays valid until the organism's state or sensor count changes:
+   class StateHandle {
+      public:
+         int Index;
+
+         StateHandle () { Index = -1; }
+         explicit StateHandle (int I) { Index = I; }
+
+         bool IsValid () const { return Index >= 0; }
+   };
+
+   class SensorHandle {
+      public:
+         int Index;
+
+         SensorHandle () { Index = -1; }
+         explicit SensorHandle (int I) { Index = I; }
+
+         bool IsValid () const { return Index >= 0; }
+   };
+
    class Organism {
+      friend class OrganismBatch;
+      friend class MappedOrganism;
+      friend class TransitionMatrix;
+      friend class SparseOrganism;
+
+      template <int States, int Sensors> friend class FixedOrganism;
+
       protected:
          class State {
             public:
@@ -55,18 +168,69 @@ namespace AdaptOrg {
 
          int StateCount, SensorCount, CurrentState;
 
+         NameIndex StateNames, SensorNames;
+
          Genome OrgGenome;
 
+         // Scratch space for UpdateState:
+         float *Workspace;
+
+         // Random number source, NULL for the calling thread's generator:
+         Generator *Rng;
+
+         // Caller-owned sensor values, BoundStride floats apart, or NULL to
+         // use the organism's own:
+         const float *BoundInputs;
+         int         BoundStride;
+
+         // Per-state alias tables, each built for the sensor values in RowInputs.
+         // RowFlags: 0 = stale, 1 = alias table, 2 = CDF only.
+         int   Sampling;
+         float *RowInputs, *AliasProb;
+         int   *AliasIndex;
+         char  *RowFlags;
+
+         // Cached mode keeps every row's weights and CDF for the sensor values
+         // in RowInputs and patches them by sensor deltas. RowFlags: 0 = stale,
+         // 1 = monotone CDF, 2 = not; RowAge counts delta updates since the
+         // row was last computed in full.
+         float *RowWeights, *RowCdf;
+         int   *RowAge;
+
          bool Free ();
+         bool FreeCache ();
+         void Swap (Organism &Org);
+         bool Reserve ();
+
+         // Call after any change to the genome. Rehash false when the
+         // genome keeps its own content hash current, as Genome::Mutate does:
+         bool Invalidate (bool Rehash = true);
+
+         bool CopyStructure (const Organism &Org);
+
+         bool Reindex ();
+
+         const float *GatherInputs ();
+
+         bool EvaluateState (int Index, const float *Inputs, float *Weights) const;
+         bool UpdateRow     (int Index, const float *Inputs);
+         int  SampleState   (int Index, const float *Inputs);
+
+         int RunSteps (int Steps, int Absorbing, const std::function<bool (int State)> *Stop, int *Trajectory);
 
       public:
          Organism  ();
          Organism (const Organism &Org);
+         Organism (Organism &&Org) noexcept;
          ~Organism ();
 
          Organism &operator = (const Organism &Org);
+         Organism &operator = (Organism &&Org);
          Organism operator  + (const Organism &Org) const;
 
+         Organism Cross (const Organism &Org, Generator &G) const;
+         bool     Cross (const Organism &Org, Organism &Child, Generator &G) const;
+
          std::string GetStateName (int Index) const;
          bool  GetStateName (int Index, std::string* Name) const;
          bool  SetStateName (int Index, std::string Name);
@@ -74,12 +238,15 @@ namespace AdaptOrg {
          bool  SetStateCount (int Count);
          int   GetStateCount () const;
 
-         int   GetStateIndex (std::string Name) const;
+         int         GetStateIndex (std::string_view Name) const;
+         StateHandle FindState     (std::string_view Name) const;
 
-         float GetSensorValue (std::string Name) const;
+         float GetSensorValue (std::string_view Name) const;
          float GetSensorValue (int Index) const;
-         bool  SetSensorValue (std::string Name, float Value);
+         float GetSensorValue (SensorHandle H) const;
+         bool  SetSensorValue (std::string_view Name, float Value);
          bool  SetSensorValue (int Index, float Value);
+         bool  SetSensorValue (SensorHandle H, float Value);
 
          std::string GetSensorName (int Index) const;
          bool  GetSensorName (int Index, std::string* Name) const;
@@ -88,22 +255,69 @@ namespace AdaptOrg {
          bool  SetSensorCount (int Count);
          int   GetSensorCount () const;
 
-         int   GetSensorIndex (std::string Name) const;
+         int          GetSensorIndex (std::string_view Name) const;
+         SensorHandle FindSensor     (std::string_view Name) const;
 
          bool SetTransition (int Index1, int Index2, float BaseChance, const float *SensorCoeff);
 
+         bool SetContiguous (bool State);
+         bool GetContiguous () const;
+
+         bool       SetGenomePool (GenomePool *P);
+         GenomePool *GetGenomePool () const;
+
+         bool SetSampling (int Mode);
+         int  GetSampling () const;
+
          int  GetCurrentState () const;
          bool GetCurrentState (std::string* Name) const;
-         bool SetCurrentState (std::string Name);
+         bool SetCurrentState (std::string_view Name);
          bool SetCurrentState (int Index);
+         bool SetCurrentState (StateHandle H);
+         bool IsCurrentState  (StateHandle H) const;
+
+         bool       SetGenerator (Generator *G);
+         Generator &GetGenerator () const;
+
+         // Reads sensor i from Inputs [i * SensorStride] on every UpdateState, so
+         // one write to the caller's array updates every bound organism. While
+         // bound, SetSensorValue fails and Save still writes the organism's
+         // own values. The array must hold SensorCount values and outlive the
+         // binding, which stays with this instance like the generator:
+         bool        BindSensors   (const float *Inputs, int SensorStride = 1);
+         bool        UnbindSensors ();
+         const float *GetBoundSensors () const;
 
          bool Mutate ();
+         bool Mutate (Generator &G);
          bool MutateMutationFactors (float Chance, float Rate);
 
          bool UpdateState ();
 
+         // Steps with the sensors held at their current values. Each visited
+         // row's CDF, or alias table in ADAPTORG_SAMPLE_ALIAS mode, is compiled
+         // once and reused for the rest of the run. Trajectory, if given,
+         // receives the state after every step. Return the steps taken;
+         // RunUntil stops early once the current state is Absorbing or
+         // satisfies Stop, checking before the first step too:
+         int Run      (int Steps, int *Trajectory = NULL);
+         int RunUntil (int MaxSteps, int Absorbing, int *Trajectory = NULL);
+         int RunUntil (int MaxSteps, const std::function<bool (int State)> &Stop, int *Trajectory = NULL);
+
+         // Hash of the genome's content, see Genome::GetHash. Organisms with
+         // equal genomes have equal hashes whatever their history:
+         unsigned long long GetContentHash () const;
+         bool               SameGenome     (const Organism &Org) const;
+
          bool Save (std::fstream &File) const;
          bool Load (std::fstream &File);
+
+         // The current state, sensor values and genome as changes from Base,
+         // whose states and sensors must match, and optionally Mate; see
+         // Genome::SaveDelta. LoadDelta takes names and shape from Base and
+         // returns the bytes used, 0 on a bad buffer:
+         bool   SaveDelta (const Organism &Base, const Organism *Mate, std::vector<char> &Out) const;
+         size_t LoadDelta (const Organism &Base, const Organism *Mate, const char *Buffer, size_t Size);
    };
 }
 
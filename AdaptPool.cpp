@@ -0,0 +1,173 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptPool.cpp
+  Purpose:      Implementation for the AdaptAI work-stealing thread pool.
+*****************************************************************************/
+
+#include "AdaptPool.h"
+
+using namespace AdaptAI;
+
+ThreadPool::ThreadPool (int Count) {
+   // Count includes the calling thread, which always helps:
+   if (Count <= 0)
+      Count = (int) std::thread::hardware_concurrency ();
+
+   if (Count <= 0)
+      Count = 1;
+
+   QueueCount = (Count > 1) ? Count - 1 : 1;
+
+   Queues = new Queue [QueueCount];
+
+   Queued   = 0;
+   Stopping = false;
+
+   for (int i = 0; i < Count - 1; i++)
+      Threads.push_back (std::thread (&ThreadPool::Work, this, i));
+}
+
+ThreadPool::~ThreadPool () {
+   {
+      std::lock_guard<std::mutex> Guard (Lock);
+
+      Stopping = true;
+   }
+
+   Wake.notify_all ();
+
+   for (size_t i = 0; i < Threads.size (); i++)
+      Threads [i].join ();
+
+   delete [] Queues;
+}
+
+int ThreadPool::GetThreadCount () const {
+   return (int) Threads.size () + 1;
+}
+
+bool ThreadPool::Pop (int Self, Task &T) {
+   int i;
+
+   // Own queue first, newest task:
+   if (Self < QueueCount) {
+      std::lock_guard<std::mutex> Guard (Queues [Self].Lock);
+
+      if (!Queues [Self].Tasks.empty ()) {
+         T = Queues [Self].Tasks.back ();
+
+         Queues [Self].Tasks.pop_back ();
+
+         return true;
+      }
+   }
+
+   // Then steal the oldest task of another queue:
+   for (i = 1; i <= QueueCount; i++) {
+      Queue &Victim = Queues [(Self + i) % QueueCount];
+
+      std::lock_guard<std::mutex> Guard (Victim.Lock);
+
+      if (!Victim.Tasks.empty ()) {
+         T = Victim.Tasks.front ();
+
+         Victim.Tasks.pop_front ();
+
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void ThreadPool::Run (Task &T) {
+   Queued--;
+
+   (*T.Body) (T.First, T.Last);
+
+   if (--(*T.Remaining) == 0) {
+      // Take the lock so the waiting caller can't miss the wake up:
+      {
+         std::lock_guard<std::mutex> Guard (Lock);
+      }
+
+      Done.notify_all ();
+   }
+}
+
+void ThreadPool::Work (int Self) {
+   for (;;) {
+      Task T;
+
+      if (Pop (Self, T)) {
+         Run (T);
+
+         continue;
+      }
+
+      std::unique_lock<std::mutex> Guard (Lock);
+
+      Wake.wait (Guard, [this] { return Stopping || Queued > 0; });
+
+      if (Stopping && Queued == 0)
+         return;
+   }
+}
+
+bool ThreadPool::ParallelFor (int Count, const Function &Body, int Grain) {
+   if (Count <= 0)
+      return true;
+
+   if (Grain <= 0) {
+      // A few pieces per thread leaves room for stealing:
+      Grain = Count / (4 * GetThreadCount ());
+
+      if (Grain < 1)
+         Grain = 1;
+   }
+
+   int Pieces = (Count + Grain - 1) / Grain;
+
+   std::atomic<int> Remaining (Pieces);
+
+   for (int i = 0; i < Pieces; i++) {
+      Task T;
+
+      T.First     = i * Grain;
+      T.Last      = (T.First + Grain < Count) ? T.First + Grain : Count;
+      T.Body      = &Body;
+      T.Remaining = &Remaining;
+
+      Queue &Q = Queues [i % QueueCount];
+
+      std::lock_guard<std::mutex> Guard (Q.Lock);
+
+      Q.Tasks.push_back (T);
+   }
+
+   Queued += Pieces;
+
+   {
+      std::lock_guard<std::mutex> Guard (Lock);
+   }
+
+   Wake.notify_all ();
+
+   // Help until our own pieces are finished:
+   while (Remaining > 0) {
+      Task T;
+
+      if (Pop (QueueCount, T)) {
+         Run (T);
+
+         continue;
+      }
+
+      std::unique_lock<std::mutex> Guard (Lock);
+
+      Done.wait (Guard, [&Remaining] { return Remaining == 0; });
+   }
+
+   return true;
+}
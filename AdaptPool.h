@@ -0,0 +1,70 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptPool.h
+  Purpose:      Declaration for the AdaptAI work-stealing thread pool.
+*****************************************************************************/
+
+#ifndef __ADAPTPOOLH__
+#define __ADAPTPOOLH__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AdaptAI {
+
+   // Fixed set of workers, each with its own task deque. A worker takes its
+   // newest task first and steals the oldest task of another worker when it
+   // runs dry. Threads calling ParallelFor help out until their loop is done,
+   // so loops may nest.
+   class ThreadPool {
+      public:
+         typedef std::function<void (int First, int Last)> Function;
+
+      protected:
+         class Task {
+            public:
+               int First, Last;
+
+               const Function   *Body;
+               std::atomic<int> *Remaining;
+         };
+
+         class Queue {
+            public:
+               std::mutex       Lock;
+               std::deque<Task> Tasks;
+         };
+
+         std::vector<std::thread> Threads;
+
+         Queue *Queues;
+         int   QueueCount;
+
+         std::mutex              Lock;
+         std::condition_variable Wake, Done;
+         std::atomic<int>        Queued;
+         bool                    Stopping;
+
+         bool Pop  (int Self, Task &T);
+         void Run  (Task &T);
+         void Work (int Self);
+
+      public:
+         ThreadPool  (int Count = 0);
+         ~ThreadPool ();
+
+         int GetThreadCount () const;
+
+         // Calls Body (First, Last) over [0, Count) in pieces of about Grain
+         // indices (0 picks a size) and returns once every piece is done:
+         bool ParallelFor (int Count, const Function &Body, int Grain = 0);
+   };
+}
+
+#endif
@@ -0,0 +1,1050 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptPop.cpp
+  Purpose:      Implementation for the AdaptOrg population engine.
+*****************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "AdaptPop.h"
+
+using namespace AdaptOrg;
+
+// Stream phases within a generation:
+#define ADAPTPOP_PHASE_POPULATE 0
+#define ADAPTPOP_PHASE_EVALUATE 1
+#define ADAPTPOP_PHASE_BREED    2
+#define ADAPTPOP_PHASE_EPISODE  3
+
+// Checkpoint record types:
+#define ADAPTPOP_RECORD_FULL  0
+#define ADAPTPOP_RECORD_DELTA 1
+#define ADAPTPOP_RECORD_END   2
+
+// Magic, type and body size:
+#define ADAPTPOP_RECORD_HEADER (4 + sizeof (int) + sizeof (long long))
+
+// Marks the end of the log at File's put position, which is left where it
+// was so the next record goes over the marker. Whatever an older, longer
+// log left past it is never read back:
+static bool WriteEnd (std::fstream &File) {
+   std::streampos At = File.tellp ();
+
+   int       Type = ADAPTPOP_RECORD_END;
+   long long Size = 0;
+
+   File.write ("ACKP", 4);
+   File.write ((const char *) &Type, sizeof (int));
+   File.write ((const char *) &Size, sizeof (long long));
+   File.seekp (At);
+
+   return File.good ();
+}
+
+Population::Population () {
+   Evaluated = false;
+
+   EpisodeCount = 0;
+
+   Caching   = true;
+   CacheHits = 0;
+
+   Pool    = NULL;
+   OwnPool = false;
+
+   Seed = 0;
+
+   Generation     = 0;
+   EliteCount     = 1;
+   TournamentSize = 2;
+
+   CheckpointInterval = 10;
+   SinceFull          = -1;
+}
+
+Population::~Population () {
+   if (OwnPool)
+      delete Pool;
+}
+
+Philox Population::Stream (int Phase, int Index) const {
+   // Stream id is (generation, phase, member):
+   unsigned long long Id = ((unsigned long long) Generation << 34) |
+                           ((unsigned long long) Phase << 32) |
+                           (unsigned int) Index;
+
+   return Philox (Seed, Id);
+}
+
+bool Population::GetPool () {
+   if (Pool == NULL) {
+      Pool    = new ThreadPool ();
+      OwnPool = true;
+   }
+
+   return true;
+}
+
+bool Population::SetSeed (unsigned long long S) {
+   Seed = S;
+
+   return true;
+}
+
+unsigned long long Population::GetSeed () const {
+   return Seed;
+}
+
+bool Population::SetThreadPool (ThreadPool *P) {
+   if (OwnPool)
+      delete Pool;
+
+   // NULL makes the population start its own pool when first needed:
+   Pool    = P;
+   OwnPool = false;
+
+   return true;
+}
+
+bool Population::SetFitnessFunction (const FitnessFunction &F) {
+   Score = F;
+
+   Episode      = nullptr;
+   EpisodeCount = 0;
+
+   // Old scores came from another function:
+   Cache.clear ();
+
+   Evaluated = false;
+
+   return true;
+}
+
+bool Population::SetEpisodeFunction (const EpisodeFunction &F, int Episodes) {
+   if (Episodes < 1)
+      return false;
+
+   Episode      = F;
+   EpisodeCount = Episodes;
+
+   Score = nullptr;
+
+   Cache.clear ();
+
+   Evaluated = false;
+
+   return true;
+}
+
+int Population::GetEpisodeCount () const {
+   return EpisodeCount;
+}
+
+bool Population::SetFitnessCache (bool State) {
+   Caching = State;
+
+   if (!Caching) {
+      Cache.clear ();
+      CacheGenomes.clear ();
+      CacheFitness.clear ();
+   }
+
+   return true;
+}
+
+bool Population::GetFitnessCache () const {
+   return Caching;
+}
+
+int Population::GetCacheHits () const {
+   return CacheHits;
+}
+
+bool Population::SetEliteCount (int Count) {
+   if (Count < 0)
+      return false;
+
+   EliteCount = Count;
+
+   return true;
+}
+
+int Population::GetEliteCount () const {
+   return EliteCount;
+}
+
+bool Population::SetTournamentSize (int Count) {
+   if (Count < 1)
+      return false;
+
+   TournamentSize = Count;
+
+   return true;
+}
+
+int Population::GetTournamentSize () const {
+   return TournamentSize;
+}
+
+bool Population::Add (const Organism &Org) {
+   // Every member must be able to mate with every other:
+   if (!Members.empty ()) {
+      if (Org.GetStateCount () != Members [0].GetStateCount () ||
+          Org.GetSensorCount () != Members [0].GetSensorCount ())
+         return false;
+   }
+
+   Members.push_back (Org);
+
+   Origin.clear ();
+
+   // Growing the vector copies members off the pool, hand it back to all:
+   for (size_t i = 0; i < Members.size (); i++)
+      Members [i].SetGenomePool (&Blocks);
+
+   Evaluated = false;
+
+   return true;
+}
+
+bool Population::Populate (const Organism &Org, int Count) {
+   if (Count < 1)
+      return false;
+
+   Members.assign (Count, Org);
+
+   Origin.clear ();
+
+   for (int i = 0; i < Count; i++)
+      Members [i].SetGenomePool (&Blocks);
+
+   Evaluated = false;
+
+   GetPool ();
+
+   // Org itself plus Count - 1 mutated copies:
+   Pool->ParallelFor (Count - 1, [this] (int First, int Last) {
+      for (int i = First; i < Last; i++) {
+         Philox Rng = Stream (ADAPTPOP_PHASE_POPULATE, i + 1);
+
+         Members [i + 1].Mutate (Rng);
+      }
+   });
+
+   return true;
+}
+
+bool Population::Clear () {
+   Members.clear ();
+   Fitness.clear ();
+   Spare.clear ();
+   Cache.clear ();
+   CacheGenomes.clear ();
+   CacheFitness.clear ();
+
+   Baseline.clear ();
+   Origin.clear ();
+
+   SinceFull = -1;
+
+   Blocks.Trim ();
+
+   Evaluated  = false;
+   Generation = 0;
+
+   return true;
+}
+
+int Population::GetSize () const {
+   return (int) Members.size ();
+}
+
+int Population::GetGeneration () const {
+   return Generation;
+}
+
+Organism &Population::GetMember (int Index) {
+   if (Index < 0 || Index >= (int) Members.size ()) {
+      throw;
+   }
+
+   return Members [Index];
+}
+
+const Organism &Population::GetMember (int Index) const {
+   if (Index < 0 || Index >= (int) Members.size ()) {
+      throw;
+   }
+
+   return Members [Index];
+}
+
+float Population::GetFitness (int Index) const {
+   if (!Evaluated || Index < 0 || Index >= (int) Fitness.size ())
+      return 0.0F;
+
+   return Fitness [Index];
+}
+
+int Population::GetBest () const {
+   if (!Evaluated || Fitness.empty ())
+      return -1;
+
+   int Best = 0;
+
+   for (int i = 1; i < (int) Fitness.size (); i++) {
+      if (Fitness [i] > Fitness [Best])
+         Best = i;
+   }
+
+   return Best;
+}
+
+int Population::Select (Generator &Rng) const {
+   int Count = (int) Members.size ();
+
+   // Tournament, ties go to the lower index so the result is well defined:
+   int Best = -1;
+
+   for (int t = 0; t < TournamentSize; t++) {
+      int c = (int) (Rng.Random () * Count);
+
+      if (c >= Count)
+         c = Count - 1;
+
+      if (Best < 0 || Fitness [c] > Fitness [Best] || (Fitness [c] == Fitness [Best] && c < Best))
+         Best = c;
+   }
+
+   return Best;
+}
+
+bool Population::Evaluate () {
+   if (!Score && !Episode)
+      return false;
+
+   GetPool ();
+
+   int i, Count = (int) Members.size ();
+
+   Fitness.resize (Count);
+
+   // Members whose genome was already scored, or is about to be, keep
+   // that score:
+   std::vector<int> Pending, Original;
+
+   Pending.reserve (Count);
+
+   CacheHits = 0;
+
+   if (Caching)
+      FindDuplicates (Original);
+
+   for (i = 0; i < Count; i++) {
+      if (Caching) {
+         if (Original [i] != i) {
+            CacheHits++;
+
+            continue;
+         }
+
+         std::unordered_map<unsigned long long, int>::const_iterator Hit = Cache.find (Members [i].GetContentHash ());
+
+         // Equal hashes are compared in full, as in FindDuplicates:
+         if (Hit != Cache.end () && Members [i].SameGenome (CacheGenomes [Hit->second])) {
+            Fitness [i] = CacheFitness [Hit->second];
+
+            CacheHits++;
+
+            continue;
+         }
+      }
+
+      Pending.push_back (i);
+   }
+
+   if (Episode)
+      EvaluateEpisodes (Pending);
+   else {
+      Pool->ParallelFor ((int) Pending.size (), [&] (int First, int Last) {
+         for (int k = First; k < Last; k++) {
+            int m = Pending [k];
+
+            Philox Rng = Stream (ADAPTPOP_PHASE_EVALUATE, m);
+
+            Members [m].SetGenerator (&Rng);
+
+            Fitness [m] = Score (Members [m], Rng);
+
+            Members [m].SetGenerator (NULL);
+         }
+      });
+   }
+
+   // Only this generation's genomes are worth remembering:
+   Cache.clear ();
+
+   if (Caching) {
+      std::vector<int> Kept;
+
+      for (i = 0; i < Count; i++) {
+         Fitness [i] = Fitness [Original [i]];
+
+         // A genome colliding with an earlier one isn't cached:
+         if (Original [i] == i && Cache.emplace (Members [i].GetContentHash (), (int) Kept.size ()).second)
+            Kept.push_back (i);
+      }
+
+      CacheGenomes.resize (Kept.size ());
+      CacheFitness.resize (Kept.size ());
+
+      Pool->ParallelFor ((int) Kept.size (), [&] (int First, int Last) {
+         for (int k = First; k < Last; k++) {
+            CacheGenomes [k].SetGenomePool (&Blocks);
+
+            CacheGenomes [k] = Members [Kept [k]];
+            CacheFitness [k] = Fitness [Kept [k]];
+         }
+      });
+   }
+
+   Evaluated = true;
+
+   return true;
+}
+
+int Population::FindDuplicates (std::vector<int> &Original) {
+   GetPool ();
+
+   int i, Count = (int) Members.size (), Duplicates = 0;
+
+   // Offspring need a full pass over their genome, spread it over the pool:
+   std::vector<unsigned long long> Hashes (Count);
+
+   Pool->ParallelFor (Count, [&] (int First, int Last) {
+      for (int k = First; k < Last; k++)
+         Hashes [k] = Members [k].GetContentHash ();
+   });
+
+   Original.resize (Count);
+
+   std::unordered_map<unsigned long long, int> Seen;
+
+   for (i = 0; i < Count; i++) {
+      Original [i] = i;
+
+      std::pair<std::unordered_map<unsigned long long, int>::iterator, bool> Slot = Seen.emplace (Hashes [i], i);
+
+      // Equal hashes are compared in full before counting as duplicates:
+      if (!Slot.second && Members [i].SameGenome (Members [Slot.first->second])) {
+         Original [i] = Slot.first->second;
+
+         Duplicates++;
+      }
+   }
+
+   return Duplicates;
+}
+
+bool Population::EvaluateEpisodes (const std::vector<int> &Pending) {
+   int Items = (int) Pending.size () * EpisodeCount;
+
+   std::vector<float> Scores (Items);
+
+   // Every (member, episode) pair is its own work item:
+   Pool->ParallelFor (Items, [&] (int First, int Last) {
+      Organism Org;
+
+      // From the members' pool, so the copies share their genome data:
+      Org.SetGenomePool (&Blocks);
+
+      for (int t = First; t < Last; t++) {
+         int m = Pending [t / EpisodeCount], e = t % EpisodeCount;
+
+         // Copied again for every episode, into buffers of the same shape,
+         // so nothing the last episode did to it carries over. Assignment
+         // leaves bindings alone, those are dropped by hand:
+         Org = Members [m];
+
+         Org.UnbindSensors ();
+
+         for (int k = 0; k < Org.GetSensorCount (); k++)
+            Org.SetSensorValue (k, Members [m].GetSensorValue (k));
+
+         Philox Rng = Stream (ADAPTPOP_PHASE_EPISODE, m * EpisodeCount + e);
+
+         Org.SetGenerator (&Rng);
+
+         Scores [t] = Episode (Org, Rng, e);
+
+         Org.SetGenerator (NULL);
+      }
+   });
+
+   // Reduce in episode order:
+   for (int k = 0; k < (int) Pending.size (); k++) {
+      double Sum = 0.0;
+
+      for (int e = 0; e < EpisodeCount; e++)
+         Sum += Scores [k * EpisodeCount + e];
+
+      Fitness [Pending [k]] = (float) (Sum / EpisodeCount);
+   }
+
+   return true;
+}
+
+bool Population::Evolve () {
+   if (Members.empty ())
+      return false;
+
+   if (!Evaluated && !Evaluate ())
+      return false;
+
+   int i, Count = (int) Members.size ();
+
+   // Rank by fitness, ties by index:
+   std::vector<int> Order (Count);
+
+   for (i = 0; i < Count; i++)
+      Order [i] = i;
+
+   std::stable_sort (Order.begin (), Order.end (), [this] (int a, int b) {
+      return Fitness [a] > Fitness [b];
+   });
+
+   int Elites = (EliteCount < Count) ? EliteCount : Count;
+
+   std::vector<Organism> &Next = Spare;
+
+   Next.resize (Count);
+
+   for (i = 0; i < Count; i++)
+      Next [i].SetGenomePool (&Blocks);
+
+   // Lineage back to the last checkpoint, through each parent's first:
+   bool Tracking = ((int) Origin.size () == 2 * Count);
+
+   std::vector<int> NextOrigin (Tracking ? 2 * Count : 0);
+
+   // Elites carry over, every other slot is bred on its own stream:
+   Pool->ParallelFor (Count, [&] (int First, int Last) {
+      for (int k = First; k < Last; k++) {
+         if (k < Elites) {
+            Next [k] = Members [Order [k]];
+
+            if (Tracking) {
+               NextOrigin [2 * k]     = Origin [2 * Order [k]];
+               NextOrigin [2 * k + 1] = Origin [2 * Order [k] + 1];
+            }
+
+            continue;
+         }
+
+         Philox Rng = Stream (ADAPTPOP_PHASE_BREED, k);
+
+         int a = Select (Rng);
+         int b = Select (Rng);
+
+         Members [a].Cross (Members [b], Next [k], Rng);
+
+         if (Tracking) {
+            NextOrigin [2 * k]     = Origin [2 * a];
+            NextOrigin [2 * k + 1] = Origin [2 * b];
+         }
+      }
+   });
+
+   Members.swap (Next);
+
+   Origin.swap (NextOrigin);
+
+   Generation++;
+
+   Evaluated = false;
+
+   return true;
+}
+
+bool Population::Evolve (int Generations) {
+   for (int i = 0; i < Generations; i++) {
+      if (!Evolve ())
+         return false;
+   }
+
+   return true;
+}
+
+bool Population::SetCheckpointInterval (int Interval) {
+   if (Interval < 1)
+      return false;
+
+   CheckpointInterval = Interval;
+
+   return true;
+}
+
+int Population::GetCheckpointInterval () const {
+   return CheckpointInterval;
+}
+
+bool Population::Rebase () {
+   GetPool ();
+
+   int Count = (int) Members.size ();
+
+   // Deltas from here on are against the members as they are now:
+   Baseline.resize (Count);
+   Origin.resize (2 * Count);
+
+   Pool->ParallelFor (Count, [this] (int First, int Last) {
+      for (int k = First; k < Last; k++) {
+         Baseline [k].SetGenomePool (&Blocks);
+
+         Baseline [k] = Members [k];
+
+         Origin [2 * k]     = k;
+         Origin [2 * k + 1] = -1;
+      }
+   });
+
+   return true;
+}
+
+bool Population::SaveCheckpoint (std::fstream &File) {
+   // Record format:
+   //          Magic              "ACKP"
+   //          Type               sizeof (int), 0 full, 1 delta or 2 end
+   //          Size               sizeof (long long), bytes in the body,
+   //                             written last so a torn record shows
+   //          Body               Size bytes, none for the end marker
+   //
+   // An end marker follows the last record.
+   //
+   // Full body:
+   //          Generation         sizeof (int)
+   //          EliteCount         sizeof (int)
+   //          TournamentSize     sizeof (int)
+   //          Seed               sizeof (unsigned long long)
+   //          Evaluated          1 byte
+   //          Count              sizeof (int)
+   //          Members            Organism::Save x Count
+   //          Fitness            sizeof (float) x Count, if Evaluated
+   //          CacheCount         sizeof (int)
+   //          Cache              (Member, Fitness) x CacheCount, by member
+   //
+   // Delta body:
+   //          Generation         sizeof (int)
+   //          Evaluated          1 byte
+   //          Count              sizeof (int)
+   //          Members            (Base, Mate, Size, Organism::SaveDelta) x Count,
+   //                             indexes into the previous record's members,
+   //                             Mate -1 for none, Size sizeof (int)
+   //          Fitness            sizeof (float) x Count, if Evaluated
+   //          CacheCount         sizeof (int)
+   //          Cache              (Member, Fitness) x CacheCount, by member
+   GetPool ();
+
+   int i, Count = (int) Members.size ();
+
+   bool Full = (SinceFull < 0 || SinceFull + 1 >= CheckpointInterval ||
+                (int) Origin.size () != 2 * Count);
+
+   std::vector<std::vector<char>> Deltas;
+   std::vector<char>              Done;
+
+   if (!Full) {
+      Deltas.resize (Count);
+      Done.resize (Count);
+
+      // Each member's delta is built on its own, then written in one pass:
+      Pool->ParallelFor (Count, [&] (int First, int Last) {
+         for (int k = First; k < Last; k++) {
+            int a = Origin [2 * k], b = Origin [2 * k + 1];
+
+            if (b == a)
+               Origin [2 * k + 1] = b = -1;
+
+            Done [k] = a >= 0 && Members [k].SaveDelta (Baseline [a], (b >= 0) ? &Baseline [b] : NULL, Deltas [k]);
+         }
+      });
+
+      for (i = 0; i < Count; i++) {
+         // Anything a delta can't express takes a full record:
+         if (!Done [i] || Deltas [i].size () > 0x7FFFFFFF)
+            Full = true;
+      }
+   }
+
+   std::streampos Start = File.tellp ();
+
+   int       Type = Full ? ADAPTPOP_RECORD_FULL : ADAPTPOP_RECORD_DELTA;
+   long long Size = 0;
+
+   File.write ("ACKP", 4);
+   File.write ((const char *) &Type, sizeof (int));
+   File.write ((const char *) &Size, sizeof (long long));
+
+   char Scored = Evaluated ? 1 : 0;
+
+   File.write ((const char *) &Generation, sizeof (int));
+
+   if (Full) {
+      File.write ((const char *) &EliteCount,     sizeof (int));
+      File.write ((const char *) &TournamentSize, sizeof (int));
+      File.write ((const char *) &Seed,           sizeof (unsigned long long));
+   }
+
+   File.write (&Scored, 1);
+   File.write ((const char *) &Count, sizeof (int));
+
+   for (i = 0; i < Count; i++) {
+      if (Full) {
+         if (!Members [i].Save (File))
+            return false;
+
+         continue;
+      }
+
+      int Bytes = (int) Deltas [i].size ();
+
+      File.write ((const char *) &Origin [2 * i], sizeof (int) * 2);
+      File.write ((const char *) &Bytes, sizeof (int));
+      File.write (Deltas [i].data (), Bytes);
+   }
+
+   if (Evaluated && Count > 0)
+      File.write ((const char *) Fitness.data (), sizeof (float) * Count);
+
+   // The fitness cache goes too, or a resumed run would score members the
+   // uninterrupted one takes from it. Each entry is saved as the first
+   // member carrying its genome; until Evaluate rebuilds the cache only
+   // members can hit it, so entries none of them carries are left out:
+   std::vector<std::pair<int, float>> Entries;
+
+   std::vector<char> Saved (CacheGenomes.size ());
+
+   for (i = 0; i < Count && Caching; i++) {
+      std::unordered_map<unsigned long long, int>::const_iterator Hit = Cache.find (Members [i].GetContentHash ());
+
+      if (Hit != Cache.end () && !Saved [Hit->second] && Members [i].SameGenome (CacheGenomes [Hit->second])) {
+         Saved [Hit->second] = 1;
+
+         Entries.push_back (std::make_pair (i, CacheFitness [Hit->second]));
+      }
+   }
+
+   int Cached = (int) Entries.size ();
+
+   File.write ((const char *) &Cached, sizeof (int));
+
+   for (i = 0; i < Cached; i++) {
+      File.write ((const char *) &Entries [i].first,  sizeof (int));
+      File.write ((const char *) &Entries [i].second, sizeof (float));
+   }
+
+   std::streampos End = File.tellp ();
+
+   if (!File.good () || !WriteEnd (File))
+      return false;
+
+   // Only now is the record complete:
+   Size = (long long) (End - Start) - (long long) ADAPTPOP_RECORD_HEADER;
+
+   File.seekp (Start + (std::streamoff) (4 + sizeof (int)));
+   File.write ((const char *) &Size, sizeof (long long));
+   File.seekp (End);
+   File.flush ();
+
+   if (!File.good ())
+      return false;
+
+   SinceFull = Full ? 0 : SinceFull + 1;
+
+   return Rebase ();
+}
+
+bool Population::LoadCheckpoint (std::fstream &File) {
+   GetPool ();
+
+   class Record {
+      public:
+         int            Type;
+         std::streamoff Body;
+         long long      Size;
+   };
+
+   std::vector<Record> Records;
+
+   File.clear ();
+   File.seekg (0, std::ios::end);
+
+   std::streamoff Length = File.tellg (), At = 0;
+
+   // Complete records, up to the first that isn't:
+   while (Length > 0 && At + (std::streamoff) ADAPTPOP_RECORD_HEADER <= Length) {
+      char   Magic [4];
+      Record R;
+
+      File.seekg (At);
+      File.read (Magic, 4);
+      File.read ((char *) &R.Type, sizeof (int));
+      File.read ((char *) &R.Size, sizeof (long long));
+
+      R.Body = At + ADAPTPOP_RECORD_HEADER;
+
+      if (File.good () && R.Type == ADAPTPOP_RECORD_END)
+         break;
+
+      if (!File.good () || memcmp (Magic, "ACKP", 4) != 0 ||
+          (R.Type != ADAPTPOP_RECORD_FULL && R.Type != ADAPTPOP_RECORD_DELTA) ||
+          R.Size <= 0 || R.Size > Length - R.Body)
+         break;
+
+      Records.push_back (R);
+
+      At = R.Body + R.Size;
+   }
+
+   File.clear ();
+
+   int i, First = -1;
+
+   for (i = 0; i < (int) Records.size (); i++) {
+      if (Records [i].Type == ADAPTPOP_RECORD_FULL)
+         First = i;
+   }
+
+   if (First < 0)
+      return false;
+
+   // Restored into temporaries, the population only changes on success:
+   std::vector<Organism> State;
+   std::vector<float>    Scores;
+
+   std::vector<std::pair<int, float>> Entries;
+
+   int                Gen, Elites, Tournament, Count;
+   unsigned long long Key;
+   char               Scored;
+
+   File.seekg (Records [First].Body);
+   File.read ((char *) &Gen,        sizeof (int));
+   File.read ((char *) &Elites,     sizeof (int));
+   File.read ((char *) &Tournament, sizeof (int));
+   File.read ((char *) &Key,        sizeof (unsigned long long));
+   File.read (&Scored, 1);
+   File.read ((char *) &Count,      sizeof (int));
+
+   if (!File.good () || Count < 0)
+      return false;
+
+   State.resize (Count);
+
+   for (i = 0; i < Count; i++) {
+      if (!State [i].Load (File))
+         return false;
+   }
+
+   if (Scored) {
+      Scores.resize (Count);
+
+      if (Count > 0)
+         File.read ((char *) Scores.data (), sizeof (float) * Count);
+   }
+
+   int Cached;
+
+   File.read ((char *) &Cached, sizeof (int));
+
+   std::streamoff Left = Records [First].Body + Records [First].Size - File.tellg ();
+
+   if (!File.good () || Cached < 0 || Left != (std::streamoff) Cached * (std::streamoff) (sizeof (int) + sizeof (float)))
+      return false;
+
+   Entries.resize (Cached);
+
+   for (i = 0; i < Cached; i++) {
+      File.read ((char *) &Entries [i].first,  sizeof (int));
+      File.read ((char *) &Entries [i].second, sizeof (float));
+
+      if (Entries [i].first < 0 || Entries [i].first >= Count)
+         return false;
+   }
+
+   if (!File.good ())
+      return false;
+
+   // Deltas are each against the record before; a bad one ends the replay:
+   int Last = First;
+
+   std::vector<char> Buffer;
+
+   for (int r = First + 1; r < (int) Records.size (); r++) {
+      Buffer.resize ((size_t) Records [r].Size);
+
+      File.seekg (Records [r].Body);
+      File.read (Buffer.data (), Buffer.size ());
+
+      if (!File.good ())
+         break;
+
+      const char *In = Buffer.data (), *End = In + Buffer.size ();
+
+      int  NextGen, NextCount;
+      char NextScored;
+
+      if ((size_t) (End - In) < sizeof (int) * 2 + 1)
+         break;
+
+      memcpy (&NextGen,    In, sizeof (int)); In += sizeof (int);
+      memcpy (&NextScored, In, 1);            In += 1;
+      memcpy (&NextCount,  In, sizeof (int)); In += sizeof (int);
+
+      if (NextCount < 0)
+         break;
+
+      // Find every member's delta first, then rebuild them in parallel:
+      std::vector<int>         Parents (2 * NextCount);
+      std::vector<const char*> Delta (NextCount);
+      std::vector<int>         Bytes (NextCount);
+
+      bool Good = true;
+
+      for (i = 0; i < NextCount && Good; i++) {
+         if ((size_t) (End - In) < sizeof (int) * 3) {
+            Good = false;
+
+            break;
+         }
+
+         memcpy (&Parents [2 * i], In, sizeof (int) * 2); In += sizeof (int) * 2;
+         memcpy (&Bytes [i],       In, sizeof (int));     In += sizeof (int);
+
+         Delta [i] = In;
+
+         Good = Parents [2 * i] >= 0 && Parents [2 * i] < Count &&
+                Parents [2 * i + 1] >= -1 && Parents [2 * i + 1] < Count &&
+                Bytes [i] >= 0 && (size_t) (End - In) >= (size_t) Bytes [i];
+
+         if (Good)
+            In += Bytes [i];
+      }
+
+      std::vector<float> NextScores;
+
+      if (Good && NextScored) {
+         Good = (size_t) (End - In) >= sizeof (float) * NextCount;
+
+         if (Good) {
+            NextScores.resize (NextCount);
+
+            if (NextCount > 0)
+               memcpy (NextScores.data (), In, sizeof (float) * NextCount);
+
+            In += sizeof (float) * NextCount;
+         }
+      }
+
+      std::vector<std::pair<int, float>> NextEntries;
+
+      int NextCached = -1;
+
+      if (Good && (size_t) (End - In) >= sizeof (int)) {
+         memcpy (&NextCached, In, sizeof (int));
+
+         In += sizeof (int);
+      }
+
+      Good = Good && NextCached >= 0 &&
+             (size_t) (End - In) == (size_t) NextCached * (sizeof (int) + sizeof (float));
+
+      if (!Good)
+         break;
+
+      NextEntries.resize (NextCached);
+
+      for (i = 0; i < NextCached; i++) {
+         memcpy (&NextEntries [i].first,  In, sizeof (int));   In += sizeof (int);
+         memcpy (&NextEntries [i].second, In, sizeof (float)); In += sizeof (float);
+
+         Good = Good && NextEntries [i].first >= 0 && NextEntries [i].first < NextCount;
+      }
+
+      if (!Good)
+         break;
+
+      std::vector<Organism> Next (NextCount);
+      std::vector<char>     Built (NextCount);
+
+      Pool->ParallelFor (NextCount, [&] (int Start, int Stop) {
+         for (int k = Start; k < Stop; k++) {
+            int a = Parents [2 * k], b = Parents [2 * k + 1];
+
+            Built [k] = Next [k].LoadDelta (State [a], (b >= 0) ? &State [b] : NULL, Delta [k], Bytes [k]) == (size_t) Bytes [k];
+         }
+      });
+
+      for (i = 0; i < NextCount; i++)
+         Good = Good && Built [i];
+
+      if (!Good)
+         break;
+
+      State.swap (Next);
+      Scores.swap (NextScores);
+      Entries.swap (NextEntries);
+
+      Gen    = NextGen;
+      Count  = NextCount;
+      Scored = NextScored;
+      Last   = r;
+   }
+
+   // New records go over whatever followed the last one replayed, and
+   // nothing past that is read again:
+   File.clear ();
+   File.seekp (Records [Last].Body + Records [Last].Size);
+
+   if (!WriteEnd (File))
+      return false;
+
+   File.flush ();
+
+   Members.swap (State);
+
+   for (i = 0; i < Count; i++)
+      Members [i].SetGenomePool (&Blocks);
+
+   Fitness.swap (Scores);
+
+   Spare.clear ();
+   Cache.clear ();
+
+   // Only used if this population caches at all:
+   int Kept = Caching ? (int) Entries.size () : 0;
+
+   CacheGenomes.resize (Kept);
+   CacheFitness.resize (Kept);
+
+   for (i = 0; i < Kept; i++) {
+      Cache.emplace (Members [Entries [i].first].GetContentHash (), i);
+
+      CacheGenomes [i].SetGenomePool (&Blocks);
+
+      CacheGenomes [i] = Members [Entries [i].first];
+      CacheFitness [i] = Entries [i].second;
+   }
+
+   Generation     = Gen;
+   EliteCount     = Elites;
+   TournamentSize = Tournament;
+   Seed           = Key;
+   Evaluated      = (Scored != 0);
+
+   SinceFull = Last - First;
+
+   return Rebase ();
+}
@@ -0,0 +1,162 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptPop.h
+  Purpose:      Declaration for the AdaptOrg population engine.
+*****************************************************************************/
+
+#ifndef __ADAPTPOPH__
+#define __ADAPTPOPH__
+
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "AdaptOrg.h"
+#include "AdaptPool.h"
+
+namespace AdaptOrg {
+
+   // Scores one organism. Rng is the organism's own stream for this
+   // generation and is also bound to the organism while it is scored:
+   typedef std::function<float (Organism &Org, Generator &Rng)> FitnessFunction;
+
+   // Scores one episode. Org is a private copy of the member, made afresh
+   // for every episode with no sensor binding and its sensors set to the
+   // member's values, and Rng is the stream for this (member, episode) pair:
+   typedef std::function<float (Organism &Org, Generator &Rng, int Episode)> EpisodeFunction;
+
+   // Generational evolution over a thread pool. Every random draw comes from
+   // a Philox stream keyed by (seed, generation, phase, member), so a fixed
+   // seed gives the same populations whatever the thread count.
+   class Population {
+      protected:
+         // Recycles genome blocks between generations, so it has to outlive
+         // the members:
+         GenomePool Blocks;
+
+         std::vector<Organism> Members;
+         std::vector<float>    Fitness;
+
+         // Last generation, kept so the next one is bred into its buffers:
+         std::vector<Organism> Spare;
+
+         bool Evaluated;
+
+         FitnessFunction Score;
+
+         EpisodeFunction Episode;
+         int             EpisodeCount;
+
+         // Index into CacheGenomes and CacheFitness by genome content hash,
+         // from the last evaluation, so members carried over unchanged
+         // (elites) or bred back into a genome seen last generation are not
+         // scored again. A hit still has to match the stored genome in full:
+         std::unordered_map<unsigned long long, int> Cache;
+
+         std::vector<Organism> CacheGenomes;
+         std::vector<float>    CacheFitness;
+
+         bool Caching;
+         int  CacheHits;
+
+         ThreadPool *Pool;
+         bool       OwnPool;
+
+         unsigned long long Seed;
+
+         int Generation, EliteCount, TournamentSize;
+
+         // Members as of the last checkpoint, and for each member the two of
+         // them it descends from, so the next checkpoint only has to record
+         // what breeding changed. Origin is empty when membership changed:
+         std::vector<Organism> Baseline;
+         std::vector<int>      Origin;
+
+         // Delta records since the last full one, -1 before the first:
+         int CheckpointInterval, SinceFull;
+
+         bool Rebase ();
+
+         Philox Stream (int Phase, int Index) const;
+
+         int Select (Generator &Rng) const;
+
+         bool EvaluateEpisodes (const std::vector<int> &Pending);
+
+         bool GetPool ();
+
+      public:
+         Population  ();
+         ~Population ();
+
+         bool SetSeed (unsigned long long S);
+         unsigned long long GetSeed () const;
+
+         bool SetThreadPool (ThreadPool *P);
+
+         bool SetFitnessFunction (const FitnessFunction &F);
+
+         // Fitness becomes the mean of Episodes scores. Episodes of all
+         // members are spread over the pool as separate work items and summed
+         // in episode order, so the result doesn't depend on the thread count:
+         bool SetEpisodeFunction (const EpisodeFunction &F, int Episodes);
+         int  GetEpisodeCount    () const;
+
+         // The cache assumes a member's fitness depends only on its genome;
+         // turn it off if scoring reads anything else from the organism.
+         // With it on, members with identical genomes are scored once, and a
+         // cached score stands for the episodes it was first earned on.
+         // GetCacheHits counts the members the last Evaluate didn't score:
+         bool SetFitnessCache (bool State);
+         bool GetFitnessCache () const;
+         int  GetCacheHits    () const;
+
+         // Original [i] gets the lowest index whose genome is identical to
+         // member i's, i itself if none. Returns the number of duplicates:
+         int FindDuplicates (std::vector<int> &Original);
+
+         bool SetEliteCount (int Count);
+         int  GetEliteCount () const;
+
+         bool SetTournamentSize (int Count);
+         int  GetTournamentSize () const;
+
+         bool Add      (const Organism &Org);
+         bool Populate (const Organism &Org, int Count);
+         bool Clear    ();
+
+         int  GetSize       () const;
+         int  GetGeneration () const;
+
+         Organism       &GetMember (int Index);
+         const Organism &GetMember (int Index) const;
+
+         float GetFitness (int Index) const;
+         int   GetBest    () const;
+
+         bool Evaluate ();
+         bool Evolve   ();
+         bool Evolve   (int Generations);
+
+         // A full record every Interval checkpoints, deltas against the
+         // previous checkpoint in between:
+         bool SetCheckpointInterval (int Interval);
+         int  GetCheckpointInterval () const;
+
+         // SaveCheckpoint writes a record at File's put position: a full
+         // snapshot, or only the genes and elements changed since the last
+         // checkpoint plus where each member came from. LoadCheckpoint
+         // restores the last full record and replays the deltas after it,
+         // then ends the log after the last good record and leaves the put
+         // position there, so a torn record or a stale tail is written over
+         // and never replayed. Open File binary, in and out, without app.
+         // The fitness cache is saved with each record, so a resumed run
+         // goes on exactly as an uninterrupted one would:
+         bool SaveCheckpoint (std::fstream &File);
+         bool LoadCheckpoint (std::fstream &File);
+   };
+}
+
+#endif
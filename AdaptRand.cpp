@@ -0,0 +1,156 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptRand.cpp
+  Purpose:      Implementation for the AdaptAI random number generators.
+*****************************************************************************/
+
+#include <stdlib.h>
+#include <atomic>
+
+#include "AdaptRand.h"
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+using namespace AdaptAI;
+
+//
+// Generator implementation
+//
+
+Generator::~Generator () {
+}
+
+float Generator::Random () {
+   // Top 24 bits, exactly representable as a float:
+   return (Next () >> 8) * (1.0F / 16777216.0F);
+}
+
+//
+// LibcGenerator implementation
+//
+
+unsigned int LibcGenerator::Next () {
+   // rand () may only give 15 bits, so stitch three calls together:
+   unsigned int Bits = (unsigned int) rand ();
+
+   Bits = (Bits << 15) ^ (unsigned int) rand ();
+   Bits = (Bits << 15) ^ (unsigned int) rand ();
+
+   return Bits;
+}
+
+float LibcGenerator::Random () {
+   return rand () / (float) RAND_MAX;
+}
+
+//
+// Philox implementation
+//
+
+Philox::Philox (unsigned long long S, unsigned long long Str) {
+   SetSeed (S, Str);
+}
+
+bool Philox::SetSeed (unsigned long long S, unsigned long long Str) {
+   Seed     = S;
+   Stream   = Str;
+   Position = 0;
+
+   return true;
+}
+
+unsigned long long Philox::GetSeed () const {
+   return Seed;
+}
+
+unsigned long long Philox::GetStream () const {
+   return Stream;
+}
+
+Philox Philox::Split (unsigned long long Str) const {
+   return Philox (Seed, Str);
+}
+
+bool Philox::Skip (unsigned long long Count) {
+   Position += Count;
+
+   // Landed inside a block, so Next () won't refill it:
+   if (Position % 4 != 0)
+      Generate ();
+
+   return true;
+}
+
+void Philox::Generate () {
+   // Counter is (block index, stream), key is the seed:
+   unsigned long long Index = Position / 4;
+
+   unsigned int C0 = (unsigned int) Index, C1 = (unsigned int) (Index >> 32);
+   unsigned int C2 = (unsigned int) Stream, C3 = (unsigned int) (Stream >> 32);
+   unsigned int K0 = (unsigned int) Seed,  K1 = (unsigned int) (Seed >> 32);
+
+   for (int Round = 0; Round < 10; Round++) {
+      unsigned long long P0 = 0xD2511F53ULL * C0;
+      unsigned long long P1 = 0xCD9E8D57ULL * C2;
+
+      C0 = (unsigned int) (P1 >> 32) ^ C1 ^ K0;
+      C1 = (unsigned int) P1;
+      C2 = (unsigned int) (P0 >> 32) ^ C3 ^ K1;
+      C3 = (unsigned int) P0;
+
+      K0 += 0x9E3779B9U;
+      K1 += 0xBB67AE85U;
+   }
+
+   Block [0] = C0;
+   Block [1] = C1;
+   Block [2] = C2;
+   Block [3] = C3;
+}
+
+unsigned int Philox::Next () {
+   if (Position % 4 == 0)
+      Generate ();
+
+   return Block [Position++ % 4];
+}
+
+//
+// Per-thread generators
+//
+
+static std::atomic<unsigned long long> DefaultSeed (0);
+static std::atomic<unsigned long long> NextStream  (0);
+
+static thread_local Generator *CurrentGenerator = NULL;
+
+static Philox &ThreadGenerator () {
+   // Each thread gets the next stream of the default seed on first use:
+   static thread_local Philox Default (DefaultSeed.load (), NextStream++);
+
+   return Default;
+}
+
+Generator &AdaptAI::GetGenerator () {
+   if (CurrentGenerator != NULL)
+      return *CurrentGenerator;
+
+   return ThreadGenerator ();
+}
+
+bool AdaptAI::SetGenerator (Generator *G) {
+   CurrentGenerator = G;
+
+   return true;
+}
+
+bool AdaptAI::SetSeed (unsigned long long S) {
+   DefaultSeed = S;
+
+   Philox &Default = ThreadGenerator ();
+
+   return Default.SetSeed (S, Default.GetStream ());
+}
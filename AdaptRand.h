@@ -0,0 +1,70 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptRand.h
+  Purpose:      Declaration for the AdaptAI random number generators.
+*****************************************************************************/
+
+#ifndef __ADAPTRANDH__
+#define __ADAPTRANDH__
+
+namespace AdaptAI {
+
+   // Interface every random number source implements:
+   class Generator {
+      public:
+         virtual ~Generator ();
+
+         // 32 uniformly distributed bits:
+         virtual unsigned int Next () = 0;
+
+         // Uniform float in [0, 1):
+         virtual float Random ();
+   };
+
+   // The C library's rand (), shared by every thread. Kept for reproducing
+   // old runs seeded through srand ():
+   class LibcGenerator : public Generator {
+      public:
+         unsigned int Next ();
+         float Random ();
+   };
+
+   // Philox4x32-10 counter-based generator. Every (Seed, Stream) pair is an
+   // independent sequence, so organisms or threads can each own one and runs
+   // stay reproducible no matter how work is scheduled:
+   class Philox : public Generator {
+      protected:
+         unsigned long long Seed, Stream, Position;
+
+         unsigned int Block [4];
+
+         void Generate ();
+
+      public:
+         Philox (unsigned long long S = 0, unsigned long long Str = 0);
+
+         bool SetSeed (unsigned long long S, unsigned long long Str = 0);
+         unsigned long long GetSeed   () const;
+         unsigned long long GetStream () const;
+
+         // Independent stream under the same seed:
+         Philox Split (unsigned long long Str) const;
+
+         // Jumps ahead Count numbers in O(1):
+         bool Skip (unsigned long long Count);
+
+         unsigned int Next ();
+   };
+
+   // The calling thread's generator: the one installed with SetGenerator, or
+   // else a thread-local Philox on its own stream of the default seed:
+   extern Generator &GetGenerator ();
+   extern bool SetGenerator (Generator *G);
+
+   // Reseeds the calling thread's default generator and those of threads
+   // that draw their first number afterwards:
+   extern bool SetSeed (unsigned long long S);
+}
+
+#endif
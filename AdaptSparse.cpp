@@ -0,0 +1,824 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptSparse.cpp
+  Purpose:      Implementation for the AdaptOrg sparse organism.
+*****************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "AdaptSparse.h"
+#include "AdaptKern.h"
+
+using namespace AdaptOrg;
+
+//
+// SparseOrganism implementation
+//
+
+SparseOrganism::SparseOrganism () {
+   StateCount = SensorCount = CurrentState = 0;
+
+   RowStart.assign (1, 0);
+
+   Rng = NULL;
+}
+
+SparseOrganism::SparseOrganism (const Organism &Org) {
+   StateCount = SensorCount = CurrentState = 0;
+
+   RowStart.assign (1, 0);
+
+   Rng = NULL;
+
+   Assign (Org);
+}
+
+bool SparseOrganism::Assign (const Organism &Org) {
+   int S = Org.GetStateCount (), K = Org.GetSensorCount ();
+
+   int i, j, k, Stride = 1 + K;
+
+   StateCount   = S;
+   SensorCount  = K;
+   CurrentState = Org.GetCurrentState ();
+
+   States.assign (S, Label ());
+   Sensors.assign (K, Label ());
+
+   for (i = 0; i < S; i++)
+      States [i].Name = Org.States [i].Name;
+
+   for (i = 0; i < K; i++) {
+      Sensors [i].Name  = Org.Sensors [i].Name;
+      Sensors [i].Value = Org.GetSensorValue (i);
+   }
+
+   StateNames.Build (States.data (), S);
+   SensorNames.Build (Sensors.data (), K);
+
+   RowStart.assign (1, 0);
+   Target.clear ();
+   Coeff.clear ();
+   GeneChance.clear ();
+   GeneRate.clear ();
+
+   Crossover.assign (S, 1);
+   CrossChance.assign (S, ADAPTAI_DEFAULTCHANCE);
+
+   for (i = 0; i < S; i++) {
+      Chromosome &Chrom = Org.OrgGenome.GetChromosome (i);
+
+      Crossover [i]   = Chrom.GetCrossoverState ();
+      CrossChance [i] = Chrom.GetCrossoverMutationChance ();
+
+      for (j = 0; j < S; j++) {
+         Gene &G = Chrom.GetGene (j);
+
+         for (k = 0; k < Stride && G.GetElement (k) == 0.0F; k++)
+            ;
+
+         // All zeros, leave the transition out:
+         if (k == Stride)
+            continue;
+
+         Target.push_back (j);
+
+         for (k = 0; k < Stride; k++)
+            Coeff.push_back (G.GetElement (k));
+
+         GeneChance.push_back (G.GetMutationChance ());
+         GeneRate.push_back (G.GetMutationRate ());
+      }
+
+      RowStart.push_back ((int) Target.size ());
+   }
+
+   return true;
+}
+
+bool SparseOrganism::Store (Organism &Org) const {
+   if (!Org.SetSensorCount (SensorCount) || !Org.SetStateCount (StateCount))
+      return false;
+
+   int i, j, e, S = StateCount, Stride = 1 + SensorCount;
+
+   for (i = 0; i < S; i++)
+      Org.SetStateName (i, States [i].Name);
+
+   for (i = 0; i < SensorCount; i++)
+      Org.SetSensorName (i, Sensors [i].Name);
+
+   if (Org.GetBoundSensors () == NULL) {
+      for (i = 0; i < SensorCount; i++)
+         Org.SetSensorValue (i, Sensors [i].Value);
+   }
+
+   // The dense genome goes over in its bulk buffer format, which keeps the
+   // mutation factors exactly as they are; missing genes get the defaults:
+   size_t Genes = (size_t) S * S;
+
+   std::vector<char> Buffer (ADAPTAI_BULK_HEADER + 3 * sizeof (int) * (S + Genes) + sizeof (float) * Genes * Stride, 0);
+
+   int       Version = ADAPTAI_BULK_VERSION, GeneTotal = (int) Genes;
+   long long Bytes   = Buffer.size ();
+
+   char *Out = Buffer.data ();
+
+   memcpy (Out,      ADAPTAI_BULK_MAGIC, 4);
+   memcpy (Out + 4,  &Version,           sizeof (int));
+   memcpy (Out + 8,  &S,                 sizeof (int));
+   memcpy (Out + 12, &GeneTotal,         sizeof (int));
+   memcpy (Out + 16, &Bytes,             sizeof (long long));
+
+   char  *Chroms = Out + ADAPTAI_BULK_HEADER;
+   char  *Table  = Chroms + 3 * sizeof (int) * S;
+   float *Data   = (float *) (Table + 3 * sizeof (int) * Genes);
+
+   float Chance = ADAPTAI_DEFAULTCHANCE, Rate = ADAPTAI_DEFAULTRATE;
+
+   for (i = 0; i < S; i++) {
+      int Cross = Crossover [i] ? 1 : 0;
+
+      memcpy (Chroms,     &S,               sizeof (int));
+      memcpy (Chroms + 4, &Cross,           sizeof (int));
+      memcpy (Chroms + 8, &CrossChance [i], sizeof (float));
+
+      Chroms += 3 * sizeof (int);
+
+      for (j = 0, e = RowStart [i]; j < S; j++) {
+         char *G = Table + 3 * sizeof (int) * ((size_t) i * S + j);
+
+         memcpy (G, &Stride, sizeof (int));
+
+         if (e < RowStart [i + 1] && Target [e] == j) {
+            memcpy (G + 4, &GeneChance [e], sizeof (float));
+            memcpy (G + 8, &GeneRate [e],   sizeof (float));
+
+            memcpy (Data + ((size_t) i * S + j) * Stride, &Coeff [(size_t) e * Stride], sizeof (float) * Stride);
+
+            e++;
+         }
+         else {
+            memcpy (G + 4, &Chance, sizeof (float));
+            memcpy (G + 8, &Rate,   sizeof (float));
+         }
+      }
+   }
+
+   if (Org.OrgGenome.LoadBuffer (Buffer.data (), Buffer.size ()) == 0)
+      return false;
+
+   Org.SetCurrentState (CurrentState);
+
+   return Org.Invalidate ();
+}
+
+bool SparseOrganism::SetStateCount (int Count) {
+   if (Count < 0)
+      return false;
+
+   int i, e, Stride = 1 + SensorCount;
+
+   if (Count < StateCount) {
+      // Drop the rows past the end and every entry pointing there:
+      int Kept = 0;
+
+      for (i = 0; i < Count; i++) {
+         int Begin = RowStart [i], End = RowStart [i + 1];
+
+         RowStart [i] = Kept;
+
+         for (e = Begin; e < End; e++) {
+            if (Target [e] >= Count)
+               continue;
+
+            Target [Kept]     = Target [e];
+            GeneChance [Kept] = GeneChance [e];
+            GeneRate [Kept]   = GeneRate [e];
+
+            memmove (&Coeff [(size_t) Kept * Stride], &Coeff [(size_t) e * Stride], sizeof (float) * Stride);
+
+            Kept++;
+         }
+      }
+
+      RowStart.resize (Count + 1);
+
+      RowStart [Count] = Kept;
+
+      Target.resize (Kept);
+      GeneChance.resize (Kept);
+      GeneRate.resize (Kept);
+      Coeff.resize ((size_t) Kept * Stride);
+   }
+   else RowStart.resize (Count + 1, RowStart [StateCount]);
+
+   States.resize (Count);
+   Crossover.resize (Count, 1);
+   CrossChance.resize (Count, ADAPTAI_DEFAULTCHANCE);
+
+   StateCount = Count;
+
+   StateNames.Build (States.data (), StateCount);
+
+   if (CurrentState >= StateCount)
+      CurrentState = 0;
+
+   return true;
+}
+
+int SparseOrganism::GetStateCount () const {
+   return StateCount;
+}
+
+bool SparseOrganism::SetSensorCount (int Count) {
+   if (Count < 0)
+      return false;
+
+   if (Count != SensorCount) {
+      // Every gene keeps its base chance and the surviving coefficients:
+      int Old = 1 + SensorCount, New = 1 + Count, Keep = std::min (Old, New);
+
+      std::vector<float> Resized ((size_t) Target.size () * New, 0.0F);
+
+      for (size_t e = 0; e < Target.size (); e++)
+         memcpy (&Resized [e * New], &Coeff [e * Old], sizeof (float) * Keep);
+
+      Coeff.swap (Resized);
+   }
+
+   Sensors.resize (Count);
+
+   SensorCount = Count;
+
+   SensorNames.Build (Sensors.data (), SensorCount);
+
+   return true;
+}
+
+int SparseOrganism::GetSensorCount () const {
+   return SensorCount;
+}
+
+std::string SparseOrganism::GetStateName (int Index) const {
+   if (Index < 0 || Index >= StateCount)
+      return std::string ();
+
+   return States [Index].Name;
+}
+
+bool SparseOrganism::SetStateName (int Index, std::string Name) {
+   if (Index < 0 || Index >= StateCount)
+      return false;
+
+   States [Index].Name = Name;
+
+   return StateNames.Build (States.data (), StateCount);
+}
+
+int SparseOrganism::GetStateIndex (std::string_view Name) const {
+   return StateNames.Find (States.data (), Name);
+}
+
+std::string SparseOrganism::GetSensorName (int Index) const {
+   if (Index < 0 || Index >= SensorCount)
+      return std::string ();
+
+   return Sensors [Index].Name;
+}
+
+bool SparseOrganism::SetSensorName (int Index, std::string Name) {
+   if (Index < 0 || Index >= SensorCount)
+      return false;
+
+   Sensors [Index].Name = Name;
+
+   return SensorNames.Build (Sensors.data (), SensorCount);
+}
+
+int SparseOrganism::GetSensorIndex (std::string_view Name) const {
+   return SensorNames.Find (Sensors.data (), Name);
+}
+
+float SparseOrganism::GetSensorValue (int Index) const {
+   if (Index < 0 || Index >= SensorCount)
+      return 0.0F;
+
+   return Sensors [Index].Value;
+}
+
+float SparseOrganism::GetSensorValue (std::string_view Name) const {
+   return GetSensorValue (GetSensorIndex (Name));
+}
+
+bool SparseOrganism::SetSensorValue (int Index, float Value) {
+   if (Index < 0 || Index >= SensorCount)
+      return false;
+
+   Sensors [Index].Value = Value;
+
+   return true;
+}
+
+bool SparseOrganism::SetSensorValue (std::string_view Name, float Value) {
+   return SetSensorValue (GetSensorIndex (Name), Value);
+}
+
+int SparseOrganism::Find (int From, int To) const {
+   const int *Begin = Target.data () + RowStart [From];
+   const int *End   = Target.data () + RowStart [From + 1];
+
+   const int *i = std::lower_bound (Begin, End, To);
+
+   if (i == End || *i != To)
+      return -1;
+
+   return (int) (i - Target.data ());
+}
+
+bool SparseOrganism::Insert (int From, int Entry, int To) {
+   int Stride = 1 + SensorCount;
+
+   Target.insert (Target.begin () + Entry, To);
+   GeneChance.insert (GeneChance.begin () + Entry, ADAPTAI_DEFAULTCHANCE);
+   GeneRate.insert (GeneRate.begin () + Entry, ADAPTAI_DEFAULTRATE);
+   Coeff.insert (Coeff.begin () + (size_t) Entry * Stride, Stride, 0.0F);
+
+   for (int i = From + 1; i <= StateCount; i++)
+      RowStart [i]++;
+
+   return true;
+}
+
+bool SparseOrganism::SetTransition (int Index1, int Index2, float BaseChance, const float *SensorCoeff) {
+   if (Index1 < 0 || Index1 >= StateCount || Index2 < 0 || Index2 >= StateCount)
+      return false;
+
+   int Entry = Find (Index1, Index2);
+
+   if (Entry < 0) {
+      const int *Begin = Target.data () + RowStart [Index1];
+      const int *End   = Target.data () + RowStart [Index1 + 1];
+
+      Entry = (int) (std::lower_bound (Begin, End, Index2) - Target.data ());
+
+      Insert (Index1, Entry, Index2);
+   }
+
+   float *G = &Coeff [(size_t) Entry * (1 + SensorCount)];
+
+   G [0] = BaseChance;
+
+   for (int i = 0; i < SensorCount; i++)
+      G [1 + i] = SensorCoeff [i];
+
+   return true;
+}
+
+bool SparseOrganism::RemoveTransition (int Index1, int Index2) {
+   if (Index1 < 0 || Index1 >= StateCount || Index2 < 0 || Index2 >= StateCount)
+      return false;
+
+   int Entry = Find (Index1, Index2), Stride = 1 + SensorCount;
+
+   if (Entry < 0)
+      return false;
+
+   Target.erase (Target.begin () + Entry);
+   GeneChance.erase (GeneChance.begin () + Entry);
+   GeneRate.erase (GeneRate.begin () + Entry);
+   Coeff.erase (Coeff.begin () + (size_t) Entry * Stride, Coeff.begin () + (size_t) (Entry + 1) * Stride);
+
+   for (int i = Index1 + 1; i <= StateCount; i++)
+      RowStart [i]--;
+
+   return true;
+}
+
+bool SparseOrganism::HasTransition (int Index1, int Index2) const {
+   if (Index1 < 0 || Index1 >= StateCount || Index2 < 0 || Index2 >= StateCount)
+      return false;
+
+   return Find (Index1, Index2) >= 0;
+}
+
+int SparseOrganism::GetTransitionCount () const {
+   return (int) Target.size ();
+}
+
+int SparseOrganism::GetCurrentState () const {
+   return CurrentState;
+}
+
+bool SparseOrganism::SetCurrentState (int Index) {
+   if (Index < 0 || Index >= StateCount)
+      return false;
+
+   CurrentState = Index;
+
+   return true;
+}
+
+bool SparseOrganism::SetGenerator (Generator *G) {
+   Rng = G;
+
+   return true;
+}
+
+Generator &SparseOrganism::GetGenerator () const {
+   if (Rng != NULL)
+      return *Rng;
+
+   return AdaptAI::GetGenerator ();
+}
+
+bool SparseOrganism::UpdateState () {
+   if (StateCount <= 0)
+      return false;
+
+   int Begin = RowStart [CurrentState], n = RowStart [CurrentState + 1] - Begin;
+
+   if ((int) Workspace.size () < SensorCount + n + 1)
+      Workspace.resize (SensorCount + n + 1);
+
+   float *Inputs  = Workspace.data ();
+   float *Weights = Inputs + SensorCount;
+
+   for (int i = 0; i < SensorCount; i++)
+      Inputs [i] = Sensors [i].Value;
+
+   if (n > 0)
+      EvaluateRow (&Coeff [(size_t) Begin * (1 + SensorCount)], n, 1 + SensorCount, Inputs, SensorCount, Weights);
+
+   bool  Monotone = (n > 0) && CumulateRow (Weights, n);
+   float Total    = (n > 0) ? Weights [n - 1] : 0.0F;
+
+   float Choice = GetGenerator ().Random ();
+
+   // The dense CDF repeats the previous sum at every missing transition,
+   // so only its leading zeros can ever be picked, and only by a draw of 0:
+   int Next = -1;
+
+   if (Monotone) {
+      float Goal = Choice * Total;
+
+      if (Goal <= 0.0F)
+         Next = 0;
+      else if (Goal <= Total) {
+         int k = (int) (std::lower_bound (Weights, Weights + n, Goal) - Weights);
+
+         Next = Target [Begin + std::min (k, n - 1)];
+      }
+   }
+   else {
+      if ((n == 0 || Target [Begin] > 0) && Choice <= 0.0F / Total)
+         Next = 0;
+      else {
+         for (int k = 0; k < n; k++) {
+            if (Choice <= Weights [k] / Total) {
+               Next = Target [Begin + k];
+
+               break;
+            }
+         }
+      }
+   }
+
+   if (Next >= 0)
+      CurrentState = Next;
+
+   return true;
+}
+
+bool SparseOrganism::Mutate () {
+   return Mutate (GetGenerator ());
+}
+
+bool SparseOrganism::Mutate (Generator &G) {
+   int Stride = 1 + SensorCount;
+
+   // One cursor spans the stored genes, as in Genome::Mutate:
+   MutationCursor Cursor;
+
+   for (int i = 0; i < StateCount; i++) {
+      if (G.Random () <= CrossChance [i])
+         Crossover [i] = !Crossover [i];
+
+      for (int e = RowStart [i]; e < RowStart [i + 1]; e++) {
+         float *Seq = &Coeff [(size_t) e * Stride];
+
+         if (Cursor.Chance != GeneChance [e])
+            Cursor.Reset (GeneChance [e], G);
+
+         long long k = Cursor.Gap;
+
+         while (k < Stride) {
+            Seq [k] = Seq [k] + (2.0F * G.Random () - 1.0F) * GeneRate [e];
+
+            k += 1 + Cursor.Draw (G);
+         }
+
+         Cursor.Gap = k - Stride;
+      }
+   }
+
+   return true;
+}
+
+bool SparseOrganism::MutateMutationFactors (float Chance, float Rate) {
+   return MutateMutationFactors (Chance, Rate, GetGenerator ());
+}
+
+bool SparseOrganism::MutateMutationFactors (float Chance, float Rate, Generator &G) {
+   for (int i = 0; i < StateCount; i++) {
+      if (G.Random () <= Chance) {
+         float C = CrossChance [i] + (G.Random () * 2.0F - 1.0F) * Rate;
+
+         // Clamped like Chromosome::SetCrossoverMutationChance:
+         CrossChance [i] = (C < 0.0F) ? 0.0F : ((C > 1.0F) ? 1.0F : C);
+      }
+
+      for (int e = RowStart [i]; e < RowStart [i + 1]; e++) {
+         if (G.Random () <= Chance) {
+            GeneChance [e] += (G.Random () * 2.0F - 1.0F) * Rate;
+            GeneRate [e]   += (G.Random () * 2.0F - 1.0F) * Rate;
+         }
+      }
+   }
+
+   return true;
+}
+
+bool SparseOrganism::Cross (const SparseOrganism &Mate, SparseOrganism &Child, Generator &G) const {
+   if (StateCount != Mate.StateCount || SensorCount != Mate.SensorCount)
+      return false;
+
+   int Stride = 1 + SensorCount;
+
+   // The child is built on the side, so it may be either parent:
+   std::vector<int>   NewStart (1, 0), NewTarget;
+   std::vector<float> NewCoeff, NewChance, NewRate, NewCrossChance (StateCount);
+   std::vector<char>  NewCross (StateCount);
+
+   NewStart.reserve (StateCount + 1);
+   NewTarget.reserve (std::max (Target.size (), Mate.Target.size ()));
+   NewCoeff.reserve (std::max (Coeff.size (), Mate.Coeff.size ()));
+
+   const float Zero [1] = { 0.0F };
+
+   for (int r = 0; r < StateCount; r++) {
+      bool  Cross1  = Crossover [r] != 0,  Cross2  = Mate.Crossover [r] != 0;
+      float Chance1 = CrossChance [r],     Chance2 = Mate.CrossChance [r];
+
+      if (Cross1) {
+         // 50% chance of inheriting crossover trait & mutation rate from either parent:
+         if (G.Random () < 0.5F) {
+            NewCross [r]       = Cross1;
+            NewCrossChance [r] = Chance1;
+         }
+         else {
+            NewCross [r]       = Cross2;
+            NewCrossChance [r] = Chance2;
+         }
+      }
+      else {
+         if (G.Random () < 0.5F)
+            NewCross [r] = Cross1;
+         else NewCross [r] = Cross2;
+
+         // Mutation chance is numerical average of parents:
+         NewCrossChance [r] = (Chance1 + Chance2) / 2.0F;
+      }
+
+      int a = RowStart [r], aEnd = RowStart [r + 1];
+      int b = Mate.RowStart [r], bEnd = Mate.RowStart [r + 1];
+
+      // Walk both rows' targets in order:
+      while (a < aEnd || b < bEnd) {
+         int ta = (a < aEnd) ? Target [a] : StateCount;
+         int tb = (b < bEnd) ? Mate.Target [b] : StateCount;
+         int t  = std::min (ta, tb);
+
+         int FromA = (ta == t) ? a++ : -1;
+         int FromB = (tb == t) ? b++ : -1;
+
+         if (Cross1) {
+            // 50% chance of inheriting the gene from either parent, where a
+            // missing one is inherited as missing:
+            const SparseOrganism *Parent = this;
+
+            int From = FromA;
+
+            if (G.Random () >= 0.5F) {
+               Parent = &Mate;
+               From   = FromB;
+            }
+
+            if (From < 0)
+               continue;
+
+            NewTarget.push_back (t);
+            NewCoeff.insert (NewCoeff.end (), &Parent->Coeff [(size_t) From * Stride], &Parent->Coeff [(size_t) From * Stride] + Stride);
+            NewChance.push_back (Parent->GeneChance [From]);
+            NewRate.push_back (Parent->GeneRate [From]);
+         }
+         else {
+            // Genes are numerical average of parents, with default factors
+            // like Gene::Average:
+            const float *A = (FromA >= 0) ? &Coeff [(size_t) FromA * Stride] : Zero;
+            const float *B = (FromB >= 0) ? &Mate.Coeff [(size_t) FromB * Stride] : Zero;
+
+            NewTarget.push_back (t);
+
+            for (int k = 0; k < Stride; k++)
+               NewCoeff.push_back (((FromA >= 0 ? A [k] : 0.0F) + (FromB >= 0 ? B [k] : 0.0F)) / 2.0F);
+
+            NewChance.push_back (ADAPTAI_DEFAULTCHANCE);
+            NewRate.push_back (ADAPTAI_DEFAULTRATE);
+         }
+      }
+
+      NewStart.push_back ((int) NewTarget.size ());
+   }
+
+   // The child takes this parent's names and sensor values:
+   if (&Child != this) {
+      Child.StateCount  = StateCount;
+      Child.SensorCount = SensorCount;
+      Child.States      = States;
+      Child.Sensors     = Sensors;
+      Child.StateNames  = StateNames;
+      Child.SensorNames = SensorNames;
+   }
+
+   Child.RowStart.swap (NewStart);
+   Child.Target.swap (NewTarget);
+   Child.Coeff.swap (NewCoeff);
+   Child.GeneChance.swap (NewChance);
+   Child.GeneRate.swap (NewRate);
+   Child.Crossover.swap (NewCross);
+   Child.CrossChance.swap (NewCrossChance);
+
+   Child.CurrentState = 0;
+
+   // Mutate the offspring's genome:
+   return Child.Mutate (G);
+}
+
+bool SparseOrganism::Save (std::fstream &File) const {
+   // File format:
+   //          StateCount         sizeof (int)
+   //          SensorCount        sizeof (int)
+   //          CurrentState       sizeof (int)
+   //          EntryCount         sizeof (int)
+   //          States             (Count, Name) per state, as Organism::Save
+   //          Sensors            (Count, Value, Name) per sensor, as Organism::Save
+   //          Rows               (Crossover, CrossoverMutationChance) x StateCount
+   //          RowStart           sizeof (int) x (StateCount + 1)
+   //          Entries            (Target, MutationChance, MutationRate, Coeff) x EntryCount
+   int Entries = (int) Target.size (), Stride = 1 + SensorCount, i, Count;
+
+   File.write ((const char *) &StateCount,   sizeof (int));
+   File.write ((const char *) &SensorCount,  sizeof (int));
+   File.write ((const char *) &CurrentState, sizeof (int));
+   File.write ((const char *) &Entries,      sizeof (int));
+
+   for (i = 0; i < StateCount; i++) {
+      Count = States [i].Name.size () + 1;
+
+      File.write ((const char *) &Count, sizeof (int));
+      File.write (States [i].Name.c_str (), Count);
+   }
+
+   for (i = 0; i < SensorCount; i++) {
+      Count = Sensors [i].Name.size () + 1;
+
+      File.write ((const char *) &Count,            sizeof (int));
+      File.write ((const char *) &Sensors [i].Value, sizeof (float));
+      File.write (Sensors [i].Name.c_str (), Count);
+   }
+
+   for (i = 0; i < StateCount; i++) {
+      bool Cross = Crossover [i] != 0;
+
+      File.write ((const char *) &Cross,           sizeof (bool));
+      File.write ((const char *) &CrossChance [i], sizeof (float));
+   }
+
+   File.write ((const char *) RowStart.data (), sizeof (int) * (StateCount + 1));
+
+   for (i = 0; i < Entries; i++) {
+      File.write ((const char *) &Target [i],     sizeof (int));
+      File.write ((const char *) &GeneChance [i], sizeof (float));
+      File.write ((const char *) &GeneRate [i],   sizeof (float));
+      File.write ((const char *) &Coeff [(size_t) i * Stride], sizeof (float) * Stride);
+   }
+
+   return File.good ();
+}
+
+bool SparseOrganism::Load (std::fstream &File) {
+   int S = -1, K = -1, Current = 0, Entries = -1, i, Count;
+
+   File.read ((char *) &S,       sizeof (int));
+   File.read ((char *) &K,       sizeof (int));
+   File.read ((char *) &Current, sizeof (int));
+   File.read ((char *) &Entries, sizeof (int));
+
+   if (!File.good () || S < 0 || K < 0 || Entries < 0 || (S > 0 && (Current < 0 || Current >= S)))
+      return false;
+
+   // Read into a scratch organism, this one only changes on success:
+   SparseOrganism Temp;
+
+   Temp.StateCount   = S;
+   Temp.SensorCount  = K;
+   Temp.CurrentState = Current;
+
+   Temp.States.resize (S);
+   Temp.Sensors.resize (K);
+
+   std::vector<char> Name;
+
+   for (i = 0; i < S + K; i++) {
+      File.read ((char *) &Count, sizeof (int));
+
+      if (!File.good () || Count <= 0)
+         return false;
+
+      Label &L = (i < S) ? Temp.States [i] : Temp.Sensors [i - S];
+
+      if (i >= S)
+         File.read ((char *) &L.Value, sizeof (float));
+
+      Name.resize (Count);
+
+      File.read (Name.data (), Count);
+
+      if (!File.good ())
+         return false;
+
+      L.Name.assign (Name.data (), strnlen (Name.data (), Count));
+   }
+
+   Temp.Crossover.resize (S);
+   Temp.CrossChance.resize (S);
+
+   for (i = 0; i < S; i++) {
+      bool Cross;
+
+      File.read ((char *) &Cross,                sizeof (bool));
+      File.read ((char *) &Temp.CrossChance [i], sizeof (float));
+
+      Temp.Crossover [i] = Cross;
+   }
+
+   Temp.RowStart.resize (S + 1);
+
+   File.read ((char *) Temp.RowStart.data (), sizeof (int) * (S + 1));
+
+   if (!File.good () || Temp.RowStart [0] != 0 || Temp.RowStart [S] != Entries)
+      return false;
+
+   for (i = 0; i < S; i++) {
+      if (Temp.RowStart [i] > Temp.RowStart [i + 1])
+         return false;
+   }
+
+   int Stride = 1 + K;
+
+   Temp.Target.resize (Entries);
+   Temp.GeneChance.resize (Entries);
+   Temp.GeneRate.resize (Entries);
+   Temp.Coeff.resize ((size_t) Entries * Stride);
+
+   for (i = 0; i < Entries; i++) {
+      File.read ((char *) &Temp.Target [i],     sizeof (int));
+      File.read ((char *) &Temp.GeneChance [i], sizeof (float));
+      File.read ((char *) &Temp.GeneRate [i],   sizeof (float));
+      File.read ((char *) &Temp.Coeff [(size_t) i * Stride], sizeof (float) * Stride);
+
+      if (!File.good () || Temp.Target [i] < 0 || Temp.Target [i] >= S)
+         return false;
+   }
+
+   // Targets must be strictly increasing within each row:
+   for (i = 0; i < S; i++) {
+      for (int e = Temp.RowStart [i] + 1; e < Temp.RowStart [i + 1]; e++) {
+         if (Temp.Target [e] <= Temp.Target [e - 1])
+            return false;
+      }
+   }
+
+   Temp.StateNames.Build (Temp.States.data (), S);
+   Temp.SensorNames.Build (Temp.Sensors.data (), K);
+
+   // The generator binding stays with this instance:
+   Temp.Rng = Rng;
+
+   *this = std::move (Temp);
+
+   return true;
+}
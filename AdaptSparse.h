@@ -0,0 +1,122 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptSparse.h
+  Purpose:      Declaration for the AdaptOrg sparse organism.
+*****************************************************************************/
+
+#ifndef __ADAPTSPARSEH__
+#define __ADAPTSPARSEH__
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AdaptOrg.h"
+
+namespace AdaptOrg {
+
+   // Organism that keeps only the transitions it was given, in compressed
+   // sparse rows: state r's transitions are entries RowStart [r] to
+   // RowStart [r + 1] - 1, sorted by Target, each with its own gene of
+   // 1 + SensorCount coefficients and mutation factors. A missing transition
+   // is a gene of zeros that never mutates.
+   //
+   // Stepping, mutation, crossover and Save/Load all cost time in the number
+   // of entries rather than StateCount^2. UpdateState picks the same states
+   // as a dense Organism in ADAPTORG_SAMPLE_CDF mode from the same draws, up
+   // to the row kernel's rounding. Mutation only visits stored entries, so
+   // its draws differ from the dense organism's.
+   class SparseOrganism {
+      protected:
+         class Label {
+            public:
+               std::string Name;
+               float       Value;
+
+               Label () { Value = 0.0F; }
+         };
+
+         int StateCount, SensorCount, CurrentState;
+
+         std::vector<Label> States, Sensors;
+
+         NameIndex StateNames, SensorNames;
+
+         std::vector<int>   RowStart, Target;
+         std::vector<float> Coeff, GeneChance, GeneRate;
+
+         // Per row, like a chromosome's:
+         std::vector<char>  Crossover;
+         std::vector<float> CrossChance;
+
+         // Scratch space for UpdateState:
+         std::vector<float> Workspace;
+
+         // Random number source, NULL for the calling thread's generator:
+         Generator *Rng;
+
+         // Index of entry (From, To), or -1 when it isn't stored:
+         int Find (int From, int To) const;
+
+         bool Insert (int From, int Entry, int To);
+
+      public:
+         SparseOrganism ();
+
+         // Keeps the genes of Org with a non-zero coefficient:
+         explicit SparseOrganism (const Organism &Org);
+
+         bool Assign (const Organism &Org);
+         bool Store  (Organism &Org) const;
+
+         bool SetStateCount  (int Count);
+         int  GetStateCount  () const;
+         bool SetSensorCount (int Count);
+         int  GetSensorCount () const;
+
+         std::string GetStateName  (int Index) const;
+         bool        SetStateName  (int Index, std::string Name);
+         int         GetStateIndex (std::string_view Name) const;
+
+         std::string GetSensorName  (int Index) const;
+         bool        SetSensorName  (int Index, std::string Name);
+         int         GetSensorIndex (std::string_view Name) const;
+
+         float GetSensorValue (int Index) const;
+         float GetSensorValue (std::string_view Name) const;
+         bool  SetSensorValue (int Index, float Value);
+         bool  SetSensorValue (std::string_view Name, float Value);
+
+         // Adds the transition if it isn't stored yet, which shifts the
+         // entries after it; build large graphs row by row in order:
+         bool SetTransition    (int Index1, int Index2, float BaseChance, const float *SensorCoeff);
+         bool RemoveTransition (int Index1, int Index2);
+         bool HasTransition    (int Index1, int Index2) const;
+         int  GetTransitionCount () const;
+
+         int  GetCurrentState () const;
+         bool SetCurrentState (int Index);
+
+         bool       SetGenerator (Generator *G);
+         Generator &GetGenerator () const;
+
+         bool UpdateState ();
+
+         bool Mutate ();
+         bool Mutate (Generator &G);
+
+         bool MutateMutationFactors (float Chance, float Rate);
+         bool MutateMutationFactors (float Chance, float Rate, Generator &G);
+
+         // Rows are merged target by target; a transition one parent lacks
+         // counts as a zero gene from that parent. Child may be either parent:
+         bool Cross (const SparseOrganism &Mate, SparseOrganism &Child, Generator &G) const;
+
+         bool Save (std::fstream &File) const;
+         bool Load (std::fstream &File);
+   };
+}
+
+#endif
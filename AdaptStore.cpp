@@ -0,0 +1,152 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptStore.cpp
+  Purpose:      Implementation for the AdaptAI content-addressed genome store.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "AdaptStore.h"
+
+using namespace AdaptAI;
+
+//
+// GenomeStore implementation
+//
+
+GenomeStore::GenomeStore () {
+}
+
+GenomeStore::GenomeStore (std::string Dir) {
+   SetDirectory (Dir);
+}
+
+std::string GenomeStore::GetPath (unsigned long long Key) const {
+   char Name [32];
+
+   snprintf (Name, sizeof (Name), "%016llx.agen", Key);
+
+   if (Directory.empty ())
+      return std::string (Name);
+
+   return Directory + "/" + Name;
+}
+
+int GenomeStore::GetSlot (unsigned long long Key) const {
+   struct stat Info;
+
+   if (stat (GetPath (Key).c_str (), &Info) != 0)
+      return ADAPTSTORE_FREE;
+
+   return (Info.st_size == 0) ? ADAPTSTORE_TOMBSTONE : ADAPTSTORE_USED;
+}
+
+bool GenomeStore::SetDirectory (std::string Dir) {
+   // Trailing separators would double up in the paths:
+   while (Dir.size () > 1 && Dir [Dir.size () - 1] == '/')
+      Dir.erase (Dir.size () - 1);
+
+   struct stat Info;
+
+   if (!Dir.empty () && (stat (Dir.c_str (), &Info) != 0 || !S_ISDIR (Info.st_mode)))
+      return false;
+
+   Directory = Dir;
+
+   return true;
+}
+
+std::string GenomeStore::GetDirectory () const {
+   return Directory;
+}
+
+bool GenomeStore::Put (const Genome &G, unsigned long long *Key) {
+   unsigned long long Address = G.GetHash (), Reuse = 0;
+
+   bool Tombstone = false;
+
+   // Probe from the hash until the genome or a free key turns up; removed
+   // genomes don't end the run:
+   for (;; Address++) {
+      int Slot = GetSlot (Address);
+
+      if (Slot == ADAPTSTORE_FREE)
+         break;
+
+      if (Slot == ADAPTSTORE_TOMBSTONE) {
+         if (!Tombstone) {
+            Reuse     = Address;
+            Tombstone = true;
+         }
+
+         continue;
+      }
+
+      Genome Stored;
+
+      if (!Get (Address, Stored))
+         return false;
+
+      if (Stored == G) {
+         if (Key != NULL)
+            *Key = Address;
+
+         return true;
+      }
+   }
+
+   if (Tombstone)
+      Address = Reuse;
+
+   // Written under a temporary name and renamed, so a reader never sees
+   // half a genome under its key:
+   std::string Path = GetPath (Address), Temp = Path + ".tmp";
+
+   {
+      std::fstream File (Temp.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+
+      if (!File.is_open () || !G.SaveBulk (File)) {
+         File.close ();
+
+         remove (Temp.c_str ());
+
+         return false;
+      }
+   }
+
+   if (rename (Temp.c_str (), Path.c_str ()) != 0) {
+      remove (Temp.c_str ());
+
+      return false;
+   }
+
+   if (Key != NULL)
+      *Key = Address;
+
+   return true;
+}
+
+bool GenomeStore::Get (unsigned long long Key, Genome &G) const {
+   std::fstream File (GetPath (Key).c_str (), std::ios::in | std::ios::binary);
+
+   if (!File.is_open ())
+      return false;
+
+   return G.LoadBulk (File);
+}
+
+bool GenomeStore::Contains (unsigned long long Key) const {
+   return GetSlot (Key) == ADAPTSTORE_USED;
+}
+
+bool GenomeStore::Remove (unsigned long long Key) {
+   if (GetSlot (Key) != ADAPTSTORE_USED)
+      return false;
+
+   // Emptied rather than deleted, see the tombstones above:
+   std::fstream File (GetPath (Key).c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+
+   return File.is_open ();
+}
@@ -0,0 +1,54 @@
+/*****************************************************************************
+       Copyright (c) 2002-2013 by John Oliva - All Rights Reserved
+*****************************************************************************
+  File:         AdaptStore.h
+  Purpose:      Declaration for the AdaptAI content-addressed genome store.
+*****************************************************************************/
+
+#ifndef __ADAPTSTOREH__
+#define __ADAPTSTOREH__
+
+#include <string>
+
+#include "AdaptAI.h"
+
+// What a key holds:
+#define ADAPTSTORE_FREE      0
+#define ADAPTSTORE_TOMBSTONE 1
+#define ADAPTSTORE_USED      2
+
+namespace AdaptAI {
+
+   // Archive of genomes in one directory, each saved once in the bulk format
+   // under its content hash ("0123456789abcdef.agen"). Putting a genome that
+   // is already there writes nothing. Two different genomes with the same
+   // hash are told apart by comparing them, and the later one takes the next
+   // free key, so a key always names exactly one genome. Remove leaves an
+   // empty file behind as a tombstone, so genomes further along the same
+   // probe run are still found; Put reuses the first tombstone it passed.
+   class GenomeStore {
+      protected:
+         std::string Directory;
+
+         std::string GetPath (unsigned long long Key) const;
+
+         // ADAPTSTORE_FREE, ADAPTSTORE_TOMBSTONE or ADAPTSTORE_USED:
+         int GetSlot (unsigned long long Key) const;
+
+      public:
+         GenomeStore ();
+         explicit GenomeStore (std::string Dir);
+
+         // Fails unless the directory already exists, "" being the current one:
+         bool        SetDirectory (std::string Dir);
+         std::string GetDirectory () const;
+
+         // Key, if given, gets the genome's address, new or existing:
+         bool Put      (const Genome &G, unsigned long long *Key = NULL);
+         bool Get      (unsigned long long Key, Genome &G) const;
+         bool Contains (unsigned long long Key) const;
+         bool Remove   (unsigned long long Key);
+   };
+}
+
+#endif